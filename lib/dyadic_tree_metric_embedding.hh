@@ -1,9 +1,10 @@
 #ifndef LIB_DYADIC_TREE_EMBEDDING_HH
 #define LIB_DYADIC_TREE_EMBEDDING_HH
 
+#include <algorithm>
 #include <bitset>
-#include <set>
 #include <map>
+#include <tuple>
 
 #include "heavy_path_decomposition.hh"
 #include "weight_balanced_tree.hh"
@@ -17,49 +18,322 @@ public:
     using weight_balanced_tree_type = AutocraticWeightBalancedTree<idx_type>;
     using bitpath = std::bitset<path_length>;
     using embedding_map = std::vector<std::pair<Float, Float>>;
+    using super_node_map = std::map<idx_type, weight_balanced_tree_type>;
+
+    // Order in which vertices are laid out for the whole construction.
+    // heavy_path_position relabels vertex v as HeavyPathDecomposition::pos[v]
+    // up front so that the weight balanced tree builds, the dfs and the
+    // embedding all walk the arrays contiguously along heavy paths.
+    enum class vertex_order {
+        original,
+        heavy_path_position,
+    };
 
-    explicit DyadicTreeMetricEmbedding(const tree_type &t)
+    explicit DyadicTreeMetricEmbedding(const tree_type &t,
+        vertex_order order = vertex_order::original)
         : tree{t}
+        , hpd{t}
         , point_embedding(t.size()) 
         , tree_paths{}
     {
 
-        tree = t;
-        HeavyPathDecomposition hpd(tree);
+        if (order == vertex_order::heavy_path_position) {
+            std::tie(to_relabeled, to_original) = hpd.relabel_by_position(tree);
+        }
 
-        const auto pm = fix_heavy_path_children(hpd);
+        const auto pm = fix_heavy_path_children(tree, hpd);
 
         for (const auto &[super, segment] : pm) {
-            std::vector<idx_type> super_weights;
-            std::vector<idx_type> super_children;
+            tree_embedding.emplace(
+                idx_type(super), build_super_node(tree, hpd, segment));
+        }
+
+        embed();
+    }
 
-            for (const auto v : segment) {
-                for (auto child : tree[v]) {
-                    // Ignore the heavy child.
-                    if (child == hpd.heavy[v]) { continue; }
+    // Embeds the next version of a tree (both in original order). Every heavy
+    // path whose subtree did not change and whose head keeps its label keeps
+    // the labels, coordinates and weight balanced trees of that subtree as
+    // they are. Only the heavy paths above or inside a change are labeled
+    // again, taking over the weight balanced trees that are still valid.
+    // previous is left without its weight balanced trees.
+    DyadicTreeMetricEmbedding(const tree_type &t,
+        DyadicTreeMetricEmbedding &&previous)
+        : tree{t}
+        , hpd{t}
+        , tree_embedding{std::move(previous.tree_embedding)}
+        , point_embedding(t.size())
+        , tree_paths{}
+    {
+        using node_descriptor = std::tuple<idx_type, bitpath, int>;
+        using std::make_tuple;
 
-                    super_children.push_back(child);
-                    super_weights.push_back(hpd.subtree_size[child]);
+        const auto pm = fix_heavy_path_children(tree, hpd);
+        const auto unchanged = unchanged_subtrees(t, previous);
+        const auto dummies_moved = dummy_leaves_moved(previous);
+        tree_paths.resize(tree.size());
+
+        // heads whose weight balanced tree already uses the new indices.
+        std::vector<bool> current(hpd.n, !dummies_moved);
+        std::vector<idx_type> relabeled;
+        std::vector<node_descriptor> stack{make_tuple(0, 0, 0)};
+        while (!stack.empty()) {
+            const auto [s_idx, s_path, s_depth] = stack.back();
+            stack.pop_back();
+
+            tree_paths[s_idx] = head_label(hpd, s_idx, s_path, s_depth);
+            if (s_idx >= hpd.n) {
+                continue;
+            }
+
+            const auto kept = unchanged[s_idx]
+                && previous.hpd.head[s_idx] == s_idx;
+            if (kept && previous.tree_paths[s_idx] == tree_paths[s_idx]) {
+                take_over_subtree(s_idx, previous);
+                continue;
+            }
+
+            const auto &segment = pm.at(s_idx);
+            auto it = tree_embedding.find(s_idx);
+            if (kept && it != tree_embedding.end()) {
+                if (!current[s_idx]) {
+                    renumber_dummy_leaves(it->second, previous);
                 }
+                reused_super_nodes++;
+            } else {
+                it = tree_embedding.insert_or_assign(idx_type(s_idx),
+                    build_super_node(tree, hpd, segment)).first;
             }
+            current[s_idx] = true;
 
-            tree_embedding.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(idx_type(super)),
-                std::forward_as_tuple(super_weights, super_children));
+            relabeled.insert(relabeled.end(), segment.begin(), segment.end());
+            label_light_children(it->second, s_path, tree_paths[s_idx].second,
+                [&](idx_type c, const bitpath &path, int depth) {
+                    stack.push_back(make_tuple(c, path, depth));
+                });
+        }
+
+        // Drop the weight balanced trees of paths that are gone, and renumber
+        // the taken over ones.
+        for (auto it = tree_embedding.begin(); it != tree_embedding.end();) {
+            const auto s = it->first;
+            if (s >= hpd.n || hpd.head[s] != s) {
+                it = tree_embedding.erase(it);
+                continue;
+            }
+            if (!current[s]) {
+                renumber_dummy_leaves(it->second, previous);
+            }
+            ++it;
+        }
+
+        const auto label = [&](idx_type u) -> const std::pair<bitpath, int> & {
+            return tree_paths[u];
+        };
+        for (const auto v : relabeled) {
+            point_embedding[v] = point(tree, hpd, v, label);
+        }
+        recomputed_points = relabeled.size();
+    }
+
+    // Indexed by relabeled vertex when constructed in heavy_path_position
+    // order; use inverse_permutation() to map back to the original IDs.
+    auto embedding() const -> embedding_map const { return point_embedding; }
+
+    // original vertex -> relabeled vertex (empty in original order).
+    auto permutation() const -> const std::vector<idx_type> & {
+        return to_relabeled;
+    }
+
+    // relabeled vertex -> original vertex (empty in original order).
+    auto inverse_permutation() const -> const std::vector<idx_type> & {
+        return to_original;
+    }
+
+    // Tree including the dummy leaves (indices >= decomposition().n) that
+    // were added to the heavy paths.
+    auto adjacency() const -> const tree_type & { return tree; }
+
+    auto decomposition() const -> const HeavyPathDecomposition & {
+        return hpd;
+    }
+
+    // Weight balanced tree over the light children of each heavy path,
+    // keyed by the head of the path.
+    auto super_nodes() const -> const super_node_map & {
+        return tree_embedding;
+    }
+
+    // number of weight balanced trees taken over from the previous version.
+    auto reused() const -> idx_type { return reused_super_nodes; }
+
+    // number of vertices whose coordinates were computed rather than taken
+    // over from the previous version.
+    auto recomputed() const -> idx_type { return recomputed_points; }
+
+    // Dyadic label (path bits and depth) of every heavy path head.
+    auto labels() const -> const std::vector<std::pair<bitpath, int>> & {
+        return tree_paths;
+    }
+
+    // The steps below are the pieces of the construction, they are also used
+    // by ShardedDyadicTreeMetricEmbedding to build shards separately.
+
+    using pathmap = std::map<idx_type, std::vector<idx_type>>;
+    // add the dummy node the the vertices in the heavy paths.
+    // also returns a path map i.e. a map that contains the vertices
+    // of each heavy path in order of parent to child.
+    static auto fix_heavy_path_children(tree_type &tree,
+        HeavyPathDecomposition &hpd) -> pathmap {
+        constexpr auto no_child = HeavyPathDecomposition::no_child;
+        pathmap pm;
+
+        // heads in increasing order, hpd.head grows in the loop.
+        for (idx_type path_root = 0, n = hpd.head.size(); path_root < n;
+            path_root++) {
+            if (hpd.head[path_root] != path_root) { continue; }
+            auto &segments = pm.emplace_hint(pm.end(), path_root,
+                std::vector<idx_type>{})->second;
+
+            auto it = path_root;
+            do {
+                segments.push_back(it);
+                // size <= 1
+                if (tree[it].size() == 1 ||
+                    (tree[it].size() == 0 && it != hpd.head[it])) {
+                    const auto dummy = tree.size();
+                    tree.push_back({});
+                    tree[it].push_back(dummy);
+
+                    // insert light_leaf into heavy path decomposition.
+                    hpd.parent.push_back(it);
+                    hpd.heavy.push_back(no_child);
+                    hpd.head.push_back(dummy);
+                    hpd.depth.push_back(hpd.depth[it] + 1);
+                    hpd.pos.push_back(hpd.pos.size());
+                    hpd.subtree_size.push_back(1);
+                }
+            } while ((it = hpd.heavy[it]) != no_child);
+        }
+
+        return pm;
+    }
+
+    // subtree sizes and indices of the light children of a heavy path
+    // segment, in path order.
+    static auto light_children(const tree_type &tree,
+        const HeavyPathDecomposition &hpd,
+        const std::vector<idx_type> &segment)
+        -> std::pair<std::vector<idx_type>, std::vector<idx_type>> {
+        std::vector<idx_type> super_weights;
+        std::vector<idx_type> super_children;
+
+        for (const auto v : segment) {
+            for (auto child : tree[v]) {
+                // Ignore the heavy child.
+                if (child == hpd.heavy[v]) { continue; }
+
+                super_children.push_back(child);
+                super_weights.push_back(hpd.subtree_size[child]);
+            }
         }
 
-        dfs_and_compute_point_embedding(hpd);
-        compute_embedding(hpd);
+        return std::make_pair(super_weights, super_children);
     }
 
-    auto embedding() -> embedding_map const { return point_embedding; }
+    // weight balanced tree over the light children of a heavy path segment.
+    static auto build_super_node(const tree_type &tree,
+        const HeavyPathDecomposition &hpd,
+        const std::vector<idx_type> &segment) -> weight_balanced_tree_type {
+        return weight_balanced_tree_type(light_children(tree, hpd, segment));
+    }
+
+    // label stored for the head s of a heavy path reached with the given
+    // path and depth.
+    static auto head_label(const HeavyPathDecomposition &hpd, idx_type s,
+        const bitpath &path, int depth) -> std::pair<bitpath, int> {
+        if (hpd.subtree_size[s] == 1) {
+            depth += depth;
+        }
+        return std::make_pair(path, depth);
+    }
+
+    // Walk the weight balanced tree of a super node labeled (s_path, s_depth)
+    // and emit(child, path, depth) for each of its light children.
+    template <class Emit>
+    static void label_light_children(const weight_balanced_tree_type &s,
+        const bitpath &s_path, int s_depth, Emit &&emit) {
+        using node_descriptor = std::tuple<idx_type, bitpath, int>;
+        using std::make_tuple;
+
+        std::vector<node_descriptor> wbt_stack = {
+            make_tuple(0, s_path, s_depth),
+        };
+        while (!wbt_stack.empty()) {
+            auto [v_idx, v_path, v_depth] = wbt_stack.back();
+            wbt_stack.pop_back();
+
+            const auto [l, r] = s.interval_nodes[v_idx];
+            if ((l + 1) == r) {
+                emit(s.original_index[l], v_path, v_depth + 1);
+            }
+
+            const auto &adj = s.tree[v_idx];
+            if (adj.size() >= 1) {
+                wbt_stack.push_back(make_tuple(
+                    adj[0], v_path, v_depth + 1
+                ));
+            }
+            if (adj.size() >= 2) {
+                const auto next_bit = ((path_length - 1) - (v_depth + 1));
+                wbt_stack.push_back(make_tuple(
+                    adj[1],
+                    v_path | (bitpath(1) << next_bit),
+                    v_depth + 1
+                ));
+            }
+        }
+    }
+
+    // Coordinates of v given label(u) -> (path, depth) of the heavy path heads.
+    template <class Labels>
+    static auto point(const tree_type &tree, const HeavyPathDecomposition &hpd,
+        idx_type v, const Labels &label) -> std::pair<Float, Float> {
+        const auto [h_path, h_depth] = label(hpd.head[v]);
+        const auto x = lut(h_path, h_depth);
+        const auto y = [&, &children = tree[v]]() {
+            if (children.size() == 0) {
+                return x;
+            }
+
+            std::vector<bitpath> lca_buffer;
+            std::vector<int> lca_depth;
+            for (const auto c : children) {
+                if (c == hpd.heavy[v]) { continue; }
+                const auto [bp, d] = label(c);
+                lca_buffer.push_back(bp);
+                lca_depth.push_back(d);
+            }
+            if (lca_buffer.size() == 1) {
+                return lut(lca_buffer[0], lca_depth[0]);
+            }
+
+            return lut(lca_buffer[0], lca(lca_buffer));
+        }();
+
+        return std::make_pair(x, y);
+    }
 
 private:
     tree_type tree;
-    std::map<idx_type, weight_balanced_tree_type> tree_embedding;
+    HeavyPathDecomposition hpd;
+    super_node_map tree_embedding;
     embedding_map point_embedding;
-    std::map<idx_type, std::pair<bitpath, int>> tree_paths{};
+    std::vector<std::pair<bitpath, int>> tree_paths{};
+    std::vector<idx_type> to_relabeled;
+    std::vector<idx_type> to_original;
+    idx_type reused_super_nodes = 0;
+    idx_type recomputed_points = 0;
 
     struct LUT {
         constexpr static auto start_fraction = 0.5;
@@ -115,122 +389,117 @@ private:
 
     constexpr static long double exp = 0.5;
 
-    using pathmap = std::map<idx_type, std::vector<idx_type>>;
-    // add the dummy node the the vertices in the heavy paths.
-    // also returns a path map i.e. a map that contains the vertices
-    // of each heavy path in order of parent to child.
-    auto fix_heavy_path_children(HeavyPathDecomposition &hpd) -> pathmap {
-        constexpr auto no_child = HeavyPathDecomposition::no_child;
-        pathmap pm;
-        using pathset = std::set<idx_type>;
+    void embed() {
+        tree_paths.resize(tree.size());
+        dfs_and_compute_point_embedding();
+        compute_embedding();
+        recomputed_points = hpd.n;
+    }
 
-        for (auto path_root : pathset(hpd.head.begin(), hpd.head.end())) {
-            auto &segments = pm[path_root];
+    // Whether the subtree of each vertex of t is the same as in previous,
+    // children before parents in reverse pos order. Dummy leaves are ignored.
+    auto unchanged_subtrees(const tree_type &t,
+        const DyadicTreeMetricEmbedding &previous) const -> std::vector<bool> {
+        const auto n = hpd.n;
+        std::vector<idx_type> order(n);
+        for (idx_type v = 0; v < n; v++) {
+            order[hpd.pos[v]] = v;
+        }
 
-            auto it = path_root;
-            do {
-                segments.push_back(it);
-                // size <= 1
-                if (tree[it].size() == 1 ||
-                    (tree[it].size() == 0 && it != hpd.head[it])) {
-                    const auto dummy = tree.size();
-                    tree.push_back({});
-                    tree[it].push_back(dummy);
+        std::vector<bool> unchanged(n, false);
+        for (auto i = n; i-- > 0;) {
+            const auto v = order[i];
+            if (v >= previous.hpd.n) {
+                continue;
+            }
 
-                    // insert light_leaf into heavy path decomposition.
-                    hpd.parent.push_back(it);
-                    hpd.heavy.push_back(no_child);
-                    hpd.head.push_back(dummy);
-                    hpd.depth.push_back(hpd.depth[it] + 1);
-                    hpd.pos.push_back(hpd.pos.size());
-                    hpd.subtree_size.push_back(1);
-                }
-            } while ((it = hpd.heavy[it]) != no_child);
+            const auto &before = previous.tree[v];
+            auto size = before.size();
+            if (size > 0 && before.back() >= previous.hpd.n) {
+                size--;
+            }
+            unchanged[v] = t[v].size() == size
+                && std::equal(t[v].cbegin(), t[v].cend(), before.cbegin())
+                && std::all_of(t[v].cbegin(), t[v].cend(),
+                    [&](idx_type c) { return unchanged[c]; });
         }
+        return unchanged;
+    }
 
-        return pm;
+    // The dummy leaves are numbered after all vertices, so a change anywhere
+    // can move the dummy leaves of an unchanged heavy path.
+    auto dummy_leaves_moved(const DyadicTreeMetricEmbedding &previous) const
+        -> bool {
+        return previous.hpd.n != hpd.n || previous.tree.size() != tree.size()
+            || !std::equal(hpd.parent.cbegin() + hpd.n, hpd.parent.cend(),
+                previous.hpd.parent.cbegin() + hpd.n);
+    }
+
+    void renumber_dummy_leaves(weight_balanced_tree_type &wbt,
+        const DyadicTreeMetricEmbedding &previous) const {
+        for (auto &c : wbt.original_index) {
+            if (c >= previous.hpd.n) {
+                c = tree[previous.hpd.parent[c]].back();
+            }
+        }
+    }
+
+    // Copy the labels and coordinates of the unchanged subtree of the heavy
+    // path head s, its weight balanced trees are already in tree_embedding.
+    void take_over_subtree(idx_type s,
+        const DyadicTreeMetricEmbedding &previous) {
+        std::vector<idx_type> stack{s};
+        while (!stack.empty()) {
+            const auto u = stack.back();
+            stack.pop_back();
+
+            point_embedding[u] = previous.point_embedding[u];
+            if (hpd.head[u] == u) {
+                tree_paths[u] = previous.tree_paths[u];
+                reused_super_nodes++;
+            }
+
+            for (const auto c : tree[u]) {
+                if (c < hpd.n) {
+                    stack.push_back(c);
+                }
+            }
+            const auto &before = previous.tree[u];
+            if (!before.empty() && before.back() >= previous.hpd.n) {
+                tree_paths[tree[u].back()] = previous.tree_paths[before.back()];
+            }
+        }
     }
 
     // DFS and compute the point_embedding of each vertex in original tree.
-    void dfs_and_compute_point_embedding(const HeavyPathDecomposition &hpd) {
+    void dfs_and_compute_point_embedding() {
         using node_descriptor = std::tuple<idx_type, bitpath, int>;
         using std::make_tuple;
 
         std::vector<node_descriptor> stack{make_tuple(0, 0, 0)};
         while (!stack.empty()) {
-            auto [s_idx, s_path, s_depth] = stack.back();
-            if (hpd.subtree_size[s_idx] == 1) {
-                s_depth += s_depth;
-            }
+            const auto [s_idx, s_path, s_depth] = stack.back();
+            stack.pop_back();
 
-            tree_paths[s_idx] = std::make_pair(s_path, s_depth);
+            tree_paths[s_idx] = head_label(hpd, s_idx, s_path, s_depth);
             const auto it = tree_embedding.find(s_idx);
-            stack.pop_back();
             if (it == tree_embedding.end()) {
                 continue;
             }
-            const auto s = it->second;
-
-            std::vector<node_descriptor> wbt_stack = {
-                make_tuple(0, s_path, s_depth),
-            };
-            while (!wbt_stack.empty()) {
-                auto [v_idx, v_path, v_depth] = wbt_stack.back();
-                wbt_stack.pop_back();
-
-                const auto [l, r] = s.interval_nodes[v_idx];
-                if ((l + 1) == r) {
-                    const auto v_original = s.original_index[l];
-                    stack.push_back(make_tuple(
-                        v_original,
-                        v_path,
-                        v_depth+1
-                    ));
-                }
 
-                const auto &adj = s.tree[v_idx];
-                if (adj.size() >= 1) {
-                    wbt_stack.push_back(make_tuple(
-                        adj[0], v_path, v_depth + 1
-                    ));
-                }
-                if (adj.size() >= 2) {
-                    const auto next_bit = ((path_length - 1) - (v_depth + 1));
-                    wbt_stack.push_back(make_tuple(
-                        adj[1],
-                        v_path | (bitpath(1) << next_bit),
-                        v_depth + 1
-                    ));
-                }
-            }
+            label_light_children(it->second, s_path, tree_paths[s_idx].second,
+                [&](idx_type c, const bitpath &path, int depth) {
+                    stack.push_back(make_tuple(c, path, depth));
+                });
         }
     }
 
-    const void compute_embedding(const HeavyPathDecomposition &hpd) {
-        for (int v = 0; v < hpd.n; v++) {
-            const auto &[h_path, h_depth] = tree_paths[hpd.head[v]];
-            const auto x = lut(h_path, h_depth);
-            const auto y = [&, &children = tree[v]]() {
-                if (children.size() == 0) {
-                    return x;
-                }
-
-                std::vector<bitpath> lca_buffer;
-                std::vector<int> lca_depth;
-                for (const auto c : children) {
-                    if (c == hpd.heavy[v]) { continue; }
-                    const auto &[bp, d] = tree_paths[c];
-                    lca_buffer.push_back(bp);
-                    lca_depth.push_back(d);
-                }
-                if (lca_buffer.size() == 1) {
-                    return lut(lca_buffer[0], lca_depth[0]);
-                }
-
-                return lut(lca_buffer[0], lca(lca_buffer));
-            }();
-
-            point_embedding[v] = std::make_pair(x, y);
+    const void compute_embedding() {
+        const auto label = [&](idx_type u) -> const std::pair<bitpath, int> & {
+            return tree_paths[u];
+        };
+        for (idx_type v = 0; v < hpd.n; v++) {
+            point_embedding[v] = point(tree, hpd, v, label);
         }
     }
 };
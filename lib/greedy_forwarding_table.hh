@@ -0,0 +1,208 @@
+#ifndef LIB_GREEDY_FORWARDING_TABLE_HH
+#define LIB_GREEDY_FORWARDING_TABLE_HH
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "dyadic_tree_metric_embedding.hh"
+
+// Precomputed greedy next hop tables so forwarding does not have to evaluate
+// distances between embedding coordinates for every packet.
+//
+// Every heavy path head h has a dyadic label (p, d) and every vertex in the
+// subtree of h lies on a heavy path whose label extends (p, d). Reading the
+// label bits as a 128 bit integer with a terminating 1 bit right after the
+// prefix, the label space of the subtree of h is the interval
+// [p, p + 2^(128 - d)), the light subtrees hanging off the path tile
+// [p, p + 2^(127 - d)) in path order, and h itself is the single key
+// p + 2^(127 - d) right after them.
+//
+// A vertex v on that path therefore only needs its own light children as
+// separate intervals: everything hanging below v goes to the heavy child,
+// everything else goes to the parent, and a target on the same heavy path is
+// resolved by comparing depths. The greedy next hop in the embedding is the
+// next hop along the tree path, so this is what the tables encode.
+//
+// Vertices are indexed the same way as the embedding they are built from
+// (i.e. relabeled when it was built in heavy_path_position order).
+template <class Float>
+class GreedyForwardingTables {
+public:
+    using embedding_type = DyadicTreeMetricEmbedding<Float>;
+    using idx_type = typename embedding_type::idx_type;
+    using bitpath = typename embedding_type::bitpath;
+    using key_type = unsigned __int128;
+    static constexpr auto path_length = embedding_type::path_length;
+    // next hop meaning "target is on the same heavy path".
+    static constexpr idx_type same_path = ~idx_type{0};
+
+    // Destination address: key of the heavy path and depth in the tree.
+    struct address {
+        key_type path;
+        idx_type depth;
+    };
+
+    struct forwarding_table {
+        // first key of each interval, sorted.
+        std::vector<key_type> prefixes;
+        // neighbor the interval is forwarded to (or same_path).
+        std::vector<idx_type> next_hops;
+        idx_type up;
+        idx_type down;
+        idx_type depth;
+    };
+
+    struct table_stats {
+        idx_type tables;
+        idx_type entries;
+        idx_type max_entries;
+        idx_type bytes;
+    };
+
+    explicit GreedyForwardingTables(const embedding_type &embedding,
+        unsigned threads = std::thread::hardware_concurrency())
+        : tables(embedding.decomposition().n)
+        , addresses(embedding.decomposition().n)
+    {
+        const auto n = tables.size();
+        threads = std::max(1u, std::min<unsigned>(threads, n));
+
+        const auto build_range = [&](idx_type first, idx_type last) {
+            for (idx_type v = first; v < last; v++) {
+                build_table(embedding, v);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        const auto chunk = (n + threads - 1) / threads;
+        for (unsigned w = 1; w < threads; w++) {
+            const auto first = std::min<idx_type>(n, w * chunk);
+            const auto last = std::min<idx_type>(n, first + chunk);
+            workers.emplace_back(build_range, first, last);
+        }
+        build_range(0, std::min<idx_type>(n, chunk));
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    auto address_of(idx_type v) const -> const address & {
+        return addresses[v];
+    }
+
+    auto table(idx_type v) const -> const forwarding_table & {
+        return tables[v];
+    }
+
+    // Neighbor of v to forward a packet for target to (v itself on arrival).
+    auto next_hop(idx_type v, const address &target) const -> idx_type {
+        const auto &t = tables[v];
+        const auto it = std::upper_bound(
+            t.prefixes.cbegin(), t.prefixes.cend(), target.path);
+        const auto hop = t.next_hops[std::distance(t.prefixes.cbegin(), it) - 1];
+        if (hop != same_path) {
+            return hop;
+        }
+        if (target.depth == t.depth) {
+            return v;
+        }
+        return target.depth > t.depth ? t.down : t.up;
+    }
+
+    auto stats() const -> table_stats {
+        table_stats s{tables.size(), 0, 0, 0};
+        for (const auto &t : tables) {
+            const idx_type entries = t.prefixes.size();
+            s.entries += entries;
+            s.max_entries = std::max(s.max_entries, entries);
+            s.bytes += sizeof(forwarding_table)
+                + entries * (sizeof(key_type) + sizeof(idx_type));
+        }
+        return s;
+    }
+
+private:
+    std::vector<forwarding_table> tables;
+    std::vector<address> addresses;
+
+    static auto to_key(const bitpath &bits) -> key_type {
+        const bitpath low_mask(~0ULL);
+        return key_type((bits >> 64).to_ullong()) << 64
+            | (bits & low_mask).to_ullong();
+    }
+
+    // Labels deeper than the bitpath have no room left for the terminating
+    // bit, the embedding itself is out of precision at that point anyway.
+    static auto prefix_width(int depth) -> int {
+        return path_length - std::min(depth, path_length - 1);
+    }
+
+    void build_table(const embedding_type &embedding, idx_type v) {
+        const auto &hpd = embedding.decomposition();
+        const auto &labels = embedding.labels();
+
+        const auto h = hpd.head[v];
+        const auto &[h_path, h_depth] = labels[h];
+        const auto width = prefix_width(h_depth);
+        const auto head_key = to_key(h_path) | (key_type(1) << (width - 1));
+
+        addresses[v] = address{head_key, hpd.depth[v]};
+
+        auto &t = tables[v];
+        t.up = hpd.parent[v];
+        t.down = hpd.heavy[v];
+        t.depth = hpd.depth[v];
+
+        std::vector<std::pair<key_type, idx_type>> entries{
+            std::make_pair(key_type(0), t.up),
+        };
+
+        // Light children of the whole path are the leaves of the weight
+        // balanced tree of the head, in path order.
+        const auto it = embedding.super_nodes().find(h);
+        if (it != embedding.super_nodes().end()) {
+            const auto &leaves = it->second.original_index;
+            const auto owner_depth = [&](idx_type c) {
+                return hpd.depth[hpd.parent[c]];
+            };
+            const auto own_first = std::partition_point(
+                leaves.cbegin(), leaves.cend(),
+                [&](idx_type c) { return owner_depth(c) < t.depth; });
+            const auto own_last = std::partition_point(
+                own_first, leaves.cend(),
+                [&](idx_type c) { return owner_depth(c) == t.depth; });
+
+            // Dummy leaves are not real destinations, their interval just
+            // extends the previous one.
+            for (auto c = own_first; c != own_last; c++) {
+                if (*c < hpd.n) {
+                    entries.emplace_back(to_key(labels[*c].first), *c);
+                }
+            }
+            if (own_last != leaves.cend()) {
+                entries.emplace_back(to_key(labels[*own_last].first), t.down);
+            }
+        }
+
+        entries.emplace_back(head_key, same_path);
+        if (h_depth > 0) {
+            entries.emplace_back(to_key(h_path) + (key_type(1) << width), t.up);
+        }
+
+        for (const auto &[prefix, hop] : entries) {
+            if (!t.prefixes.empty() && t.prefixes.back() == prefix) {
+                t.prefixes.pop_back();
+                t.next_hops.pop_back();
+            }
+            if (!t.next_hops.empty() && t.next_hops.back() == hop) {
+                continue;
+            }
+            t.prefixes.push_back(prefix);
+            t.next_hops.push_back(hop);
+        }
+    }
+};
+
+#endif // LIB_GREEDY_FORWARDING_TABLE_HH
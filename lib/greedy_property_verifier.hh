@@ -0,0 +1,346 @@
+#ifndef LIB_GREEDY_PROPERTY_VERIFIER_HH
+#define LIB_GREEDY_PROPERTY_VERIFIER_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dyadic_tree_metric_embedding.hh"
+
+// Distance kernels evaluate, for one source point and a batch of targets, a
+// value that is monotone in the distance. The greedy check only compares
+// distances, so the kernels skip the sqrt/acosh and stay plain loops over
+// contiguous arrays that the compiler can vectorize.
+//
+// The two coordinate kernels below check embeddings given as points of the
+// plane: the Euclidean one for planar embeddings (and the verifier's own
+// tests), the half plane one for the hyperbolic embedding of Section 5 of
+// the paper once its coordinates are computed. The (x, y) pairs returned by
+// DyadicTreeMetricEmbedding::embedding() are not such points, use
+// DyadicTreeMetricKernel for them.
+template <class Float>
+struct SquaredEuclideanKernel {
+    constexpr void operator()(Float sx, Float sy, const Float *xs,
+        const Float *ys, std::size_t count, Float *out) const {
+        for (std::size_t i = 0; i < count; i++) {
+            const auto dx = xs[i] - sx;
+            const auto dy = ys[i] - sy;
+            out[i] = dx*dx + dy*dy;
+        }
+    }
+};
+
+// Poincare half plane model: cosh(d(p, q)) = 1 + |p - q|^2 / (2 p.y q.y).
+template <class Float>
+struct HyperbolicHalfPlaneKernel {
+    constexpr void operator()(Float sx, Float sy, const Float *xs,
+        const Float *ys, std::size_t count, Float *out) const {
+        for (std::size_t i = 0; i < count; i++) {
+            const auto dx = xs[i] - sx;
+            const auto dy = ys[i] - sy;
+            out[i] = (dx*dx + dy*dy) / (ys[i] * sy);
+        }
+    }
+};
+
+// Dyadic tree metric of Section 4 of Eppstein and Goodrich, "Succinct Greedy
+// Geometric Routing Using Hyperbolic Geometry" (paper/). B is the infinite
+// binary tree, f maps its root to 1/2 and the children of a node x at level
+// i to f(x) -/+ 2^(-i-2), and |f(y) - f(y')| is the dyadic distance, always
+// less than one. A point is a pair (x, y) of nodes of B and
+//     d((x, y), (x', y')) = d_B(x, x') + |f(y) - f(y')|.
+// A vertex v is the pair of x, the node its heavy path is placed at (the
+// label of the head), and y, the lowest common ancestor in B of the
+// placements of the light children of v (y = x when v has none). Both are
+// read from the labels, so this kernel is evaluated on vertex indices.
+//
+// Lemma 2 of the paper claims greediness in this metric. The labels of
+// DyadicTreeMetricEmbedding pass on paths and caterpillars but not on
+// general trees, see "Known issues" in the README.
+template <class Float>
+class DyadicTreeMetricKernel {
+public:
+    using idx_type = std::size_t;
+    using embedding_type = DyadicTreeMetricEmbedding<Float>;
+    using key_type = unsigned __int128;
+
+    explicit DyadicTreeMetricKernel(const embedding_type &dtme)
+        : xs(dtme.decomposition().n)
+        , x_depths(dtme.decomposition().n)
+        , fs(dtme.decomposition().n)
+    {
+        const auto &hpd = dtme.decomposition();
+        const auto &labels = dtme.labels();
+        const auto &tree = dtme.adjacency();
+        const auto key = [&](idx_type u) {
+            const typename embedding_type::bitpath low_mask(~0ULL);
+            const auto &path = labels[u].first;
+            return key_type((path >> 64).to_ullong()) << 64
+                | (path & low_mask).to_ullong();
+        };
+        for (idx_type v = 0; v < hpd.n; v++) {
+            xs[v] = key(hpd.head[v]);
+            x_depths[v] = labels[hpd.head[v]].second;
+
+            auto y = xs[v];
+            auto y_depth = x_depths[v];
+            bool leaf = true;
+            for (auto c : tree[v]) {
+                if (c == hpd.heavy[v]) { continue; }
+                if (leaf) {
+                    y = key(c);
+                    y_depth = labels[c].second;
+                    leaf = false;
+                } else {
+                    y_depth = std::min(y_depth, common_prefix(y, key(c)));
+                }
+            }
+            fs[v] = f(y, y_depth);
+        }
+    }
+
+    void operator()(idx_type s, const idx_type *targets, std::size_t count,
+        Float *out) const {
+        for (std::size_t i = 0; i < count; i++) {
+            const auto t = targets[i];
+            const auto common = std::min({
+                common_prefix(xs[s], xs[t]), x_depths[s], x_depths[t]});
+            const auto dy = fs[t] - fs[s];
+            out[i] = Float(x_depths[s] + x_depths[t] - 2 * common)
+                + (dy < 0 ? -dy : dy);
+        }
+    }
+
+private:
+    std::vector<key_type> xs;
+    std::vector<int> x_depths;
+    std::vector<Float> fs;
+
+    // Labels are read from bit 126 down (bit 127 is never set).
+    static auto common_prefix(key_type lhs, key_type rhs) -> int {
+        const auto bits = lhs ^ rhs;
+        const auto high = std::uint64_t(bits >> 64);
+        const auto low = std::uint64_t(bits);
+        if (high != 0) {
+            return __builtin_clzll(high) - 1;
+        }
+        if (low != 0) {
+            return 63 + __builtin_clzll(low);
+        }
+        return std::numeric_limits<int>::max();
+    }
+
+    static auto f(key_type node, int depth) -> Float {
+        Float value = 0.5;
+        Float step = 0.25;
+        for (int k = 0; k < depth; k++, step /= 2) {
+            value += (node >> (126 - k)) & 1 ? step : -step;
+        }
+        return value;
+    }
+};
+
+// Checks the greedy property of an embedding of a tree: for every source s
+// and target t != s, some neighbor of s is strictly closer to t than s is.
+// The exhaustive check is O(n^2) distance evaluations, so each source is
+// checked against one target drawn from each of `samples` equal strata of
+// the vertex range (every target when samples >= n). In heavy path order the
+// strata follow the heavy paths, which spreads targets over the whole tree.
+template <class Float>
+class GreedyPropertyVerifier {
+public:
+    using idx_type = std::size_t;
+    using tree_type = std::vector<std::vector<idx_type>>;
+    using embedding_map = std::vector<std::pair<Float, Float>>;
+
+    struct violation {
+        idx_type source;
+        idx_type target;
+        int source_depth; // label depth of the heavy path of the source.
+        int target_depth; // label depth of the heavy path of the target.
+    };
+
+    struct report {
+        idx_type checked_pairs;
+        idx_type violating_pairs;
+        // first max_violations violating pairs, ordered by source.
+        std::vector<violation> violations;
+    };
+
+    // Children adjacency rooted at 0. Children >= points.size() (the dummy
+    // leaves of DyadicTreeMetricEmbedding) are ignored.
+    GreedyPropertyVerifier(const embedding_map &points, const tree_type &tree,
+        std::vector<int> label_depths)
+        : xs(points.size())
+        , ys(points.size())
+        , offsets(points.size() + 1, 0)
+        , depths(std::move(label_depths))
+    {
+        const auto n = points.size();
+        for (idx_type v = 0; v < n; v++) {
+            xs[v] = points[v].first;
+            ys[v] = points[v].second;
+        }
+
+        // Compressed undirected adjacency.
+        for (idx_type v = 0; v < n; v++) {
+            for (auto c : tree[v]) {
+                if (c < n) {
+                    offsets[v + 1]++;
+                    offsets[c + 1]++;
+                }
+            }
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        neighbors.resize(offsets.back());
+        auto fill = offsets;
+        for (idx_type v = 0; v < n; v++) {
+            for (auto c : tree[v]) {
+                if (c < n) {
+                    neighbors[fill[v]++] = c;
+                    neighbors[fill[c]++] = v;
+                }
+            }
+        }
+    }
+
+    explicit GreedyPropertyVerifier(const DyadicTreeMetricEmbedding<Float> &dtme)
+        : GreedyPropertyVerifier(dtme.embedding(), dtme.adjacency(),
+            head_label_depths(dtme)) {}
+
+    template <class Kernel>
+    auto verify(const Kernel &kernel, idx_type samples, std::uint64_t seed = 0,
+        unsigned threads = std::thread::hardware_concurrency(),
+        idx_type max_violations = 1024) const -> report {
+        const idx_type n = xs.size();
+        samples = std::min(samples, n);
+        threads = std::max(1u, threads);
+
+        constexpr idx_type block = 1024;
+        std::atomic<idx_type> next_block{0};
+        std::atomic<idx_type> checked{0};
+        std::atomic<idx_type> violating{0};
+        std::mutex found_mutex;
+        std::vector<violation> found;
+
+        const auto work = [&]() {
+            std::vector<idx_type> targets(samples);
+            std::vector<Float> txs(samples);
+            std::vector<Float> tys(samples);
+            std::vector<Float> source_distance(samples);
+            std::vector<Float> neighbor_distance(samples);
+            std::vector<Float> best(samples);
+            std::vector<violation> local;
+            idx_type local_checked = 0;
+            idx_type local_violating = 0;
+
+            // Kernels take either the coordinates or the vertex indices.
+            const auto evaluate = [&](const Kernel &k, idx_type u,
+                idx_type count, Float *out) {
+                if constexpr (std::is_invocable_v<const Kernel &, idx_type,
+                    const idx_type *, std::size_t, Float *>) {
+                    k(u, targets.data(), count, out);
+                } else {
+                    k(xs[u], ys[u], txs.data(), tys.data(), count, out);
+                }
+            };
+
+            for (idx_type first; (first = block * next_block++) < n;) {
+                const auto last = std::min(n, first + block);
+                for (idx_type s = first; s < last; s++) {
+                    std::uint64_t state = seed ^ (s * 0x9E3779B97F4A7C15ULL);
+                    idx_type count = 0;
+                    for (idx_type k = 0; k < samples; k++) {
+                        const auto lo = k * n / samples;
+                        const auto hi = (k + 1) * n / samples;
+                        const auto t = samples == n
+                            ? k : lo + splitmix64(state) % (hi - lo);
+                        if (t == s) { continue; }
+                        targets[count] = t;
+                        txs[count] = xs[t];
+                        tys[count] = ys[t];
+                        count++;
+                    }
+
+                    evaluate(kernel, s, count, source_distance.data());
+                    std::fill_n(best.begin(), count,
+                        std::numeric_limits<Float>::infinity());
+                    for (auto i = offsets[s]; i < offsets[s + 1]; i++) {
+                        const auto u = neighbors[i];
+                        evaluate(kernel, u, count, neighbor_distance.data());
+                        for (idx_type k = 0; k < count; k++) {
+                            best[k] = std::min(best[k], neighbor_distance[k]);
+                        }
+                    }
+
+                    local_checked += count;
+                    for (idx_type k = 0; k < count; k++) {
+                        if (best[k] < source_distance[k]) { continue; }
+                        local_violating++;
+                        if (local.size() < max_violations) {
+                            local.push_back(violation{
+                                s, targets[k], depths[s], depths[targets[k]]});
+                        }
+                    }
+                }
+            }
+
+            checked += local_checked;
+            violating += local_violating;
+            std::lock_guard<std::mutex> lock(found_mutex);
+            found.insert(found.end(), local.begin(), local.end());
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned w = 1; w < threads; w++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        std::sort(found.begin(), found.end(),
+            [](const violation &lhs, const violation &rhs) {
+                return std::make_pair(lhs.source, lhs.target)
+                    < std::make_pair(rhs.source, rhs.target);
+            });
+        if (found.size() > max_violations) {
+            found.resize(max_violations);
+        }
+        return report{checked, violating, std::move(found)};
+    }
+
+private:
+    std::vector<Float> xs;
+    std::vector<Float> ys;
+    std::vector<idx_type> offsets;
+    std::vector<idx_type> neighbors;
+    std::vector<int> depths;
+
+    static auto splitmix64(std::uint64_t &state) -> std::uint64_t {
+        auto z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    static auto head_label_depths(const DyadicTreeMetricEmbedding<Float> &dtme)
+        -> std::vector<int> {
+        const auto &hpd = dtme.decomposition();
+        std::vector<int> d(hpd.n);
+        for (idx_type v = 0; v < hpd.n; v++) {
+            d[v] = dtme.labels()[hpd.head[v]].second;
+        }
+        return d;
+    }
+};
+
+#endif // LIB_GREEDY_PROPERTY_VERIFIER_HH
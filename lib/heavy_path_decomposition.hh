@@ -1,6 +1,7 @@
 #ifndef LIB_HEAVY_LIGHT_DECOMPOSITION
 #define LIB_HEAVY_LIGHT_DECOMPOSITION
 
+#include <utility>
 #include <vector>
 
 // Create heavy path decomposition data structure to allow for fast
@@ -73,6 +74,53 @@ public:
         idx_type current_position = 0;
         decompose(0, 0, tree, current_position);
     }
+
+    // Relabel every vertex v as pos[v] in both the tree and the
+    // decomposition. Heavy paths then occupy contiguous ranges of indices,
+    // so later passes walk memory in order instead of jumping around by
+    // original vertex ID. Returns the permutation (original -> relabeled)
+    // and its inverse (relabeled -> original).
+    auto relabel_by_position(tree_type &tree)
+        -> std::pair<std::vector<idx_type>, std::vector<idx_type>> {
+        auto permutation = pos;
+        std::vector<idx_type> inverse(n);
+        for (idx_type v = 0; v < n; v++) {
+            inverse[pos[v]] = v;
+        }
+
+        const auto relabel = [&](idx_type v) -> idx_type {
+            return v == no_child ? no_child : permutation[v];
+        };
+        const auto permute = [&](std::vector<idx_type> &values, auto f) {
+            std::vector<idx_type> permuted(n);
+            for (idx_type u = 0; u < n; u++) {
+                permuted[u] = f(values[inverse[u]]);
+            }
+            values.swap(permuted);
+        };
+        const auto keep = [](idx_type v) { return v; };
+
+        tree_type relabeled_tree(n);
+        for (idx_type u = 0; u < n; u++) {
+            const auto &children = tree[inverse[u]];
+            relabeled_tree[u].reserve(children.size());
+            for (idx_type child : children) {
+                relabeled_tree[u].push_back(permutation[child]);
+            }
+        }
+        tree.swap(relabeled_tree);
+
+        permute(parent, relabel);
+        permute(depth, keep);
+        permute(heavy, relabel);
+        permute(head, relabel);
+        permute(subtree_size, keep);
+        for (idx_type u = 0; u < n; u++) {
+            pos[u] = u;
+        }
+
+        return std::make_pair(std::move(permutation), std::move(inverse));
+    }
 };
 
 #endif // LIB_HEAVY_LIGHT_DECOMPOSITION
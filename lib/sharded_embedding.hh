@@ -0,0 +1,294 @@
+#ifndef LIB_SHARDED_EMBEDDING_HH
+#define LIB_SHARDED_EMBEDDING_HH
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "dyadic_tree_metric_embedding.hh"
+
+// Builds the same embedding as DyadicTreeMetricEmbedding without ever holding
+// every weight balanced tree in one address space (Linux only).
+//
+// The coordinator computes the heavy path decomposition and labels the heavy
+// paths whose subtree is too large for one shard. The light children hanging
+// off that top part are shard roots, except for leaves which have nothing
+// left to label. Consecutive roots are grouped into shards of about the shard
+// size, so the number of shards follows the number of workers and not the
+// shape of the tree, and the shards are packed onto the worker processes by
+// size. Each worker forks off the coordinator, builds the weight balanced
+// trees of its shards one at a time and writes the labels into a memory
+// mapped label file. A second round of workers then computes the coordinates
+// of disjoint vertex ranges into the same file.
+//
+// The workers allocate after fork(), so the constructor must be called while
+// the process is single threaded: a lock on the heap held by another thread
+// at the time of the fork would never be released in the worker.
+template <class Float>
+class ShardedDyadicTreeMetricEmbedding {
+public:
+    using embedding_type = DyadicTreeMetricEmbedding<Float>;
+    using idx_type = typename embedding_type::idx_type;
+    using tree_type = typename embedding_type::tree_type;
+    using bitpath = typename embedding_type::bitpath;
+    using embedding_map = typename embedding_type::embedding_map;
+
+    // Layout of the label file: header, one label per vertex (including the
+    // dummy leaves) and one point per vertex of the original tree.
+    struct file_header {
+        char magic[8];
+        std::uint64_t n;
+        std::uint64_t labels;
+        std::uint64_t float_size;
+    };
+
+    struct label_record {
+        std::uint64_t high;
+        std::uint64_t low;
+        std::int64_t depth;
+    };
+
+    struct point_record {
+        Float x;
+        Float y;
+    };
+
+    ShardedDyadicTreeMetricEmbedding(const tree_type &t,
+        const std::string &label_file, unsigned workers)
+        : tree{t}
+        , hpd{t}
+    {
+        workers = std::max(1u, workers);
+        embedding_type::fix_heavy_path_children(tree, hpd);
+        map_label_file(label_file);
+
+        // Heavy paths above the shard size are labeled by the coordinator.
+        const auto shard_size =
+            std::max<idx_type>(1, tree.size() / (8 * workers));
+        const auto in_shard = [&](idx_type s) {
+            return s != 0 && hpd.subtree_size[s] <= shard_size;
+        };
+
+        // Leaf heads are fully labeled once their own label is written.
+        std::vector<std::vector<idx_type>> groups;
+        std::vector<idx_type> group_size;
+        write_label(0, embedding_type::head_label(hpd, 0, bitpath(0), 0));
+        label_from({0}, [&](idx_type c) {
+            if (hpd.subtree_size[c] == 1) { return false; }
+            if (!in_shard(c)) { return true; }
+            if (groups.empty() || group_size.back() >= shard_size) {
+                groups.emplace_back();
+                group_size.push_back(0);
+            }
+            groups.back().push_back(c);
+            group_size.back() += hpd.subtree_size[c];
+            return false;
+        });
+
+        // Longest processing time first.
+        std::vector<idx_type> order(groups.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](idx_type lhs, idx_type rhs) {
+            return group_size[lhs] > group_size[rhs];
+        });
+        std::vector<std::vector<idx_type>> assignment(workers);
+        std::vector<idx_type> load(workers, 0);
+        for (const auto g : order) {
+            const auto w = std::distance(load.begin(),
+                std::min_element(load.begin(), load.end()));
+            assignment[w].insert(assignment[w].end(),
+                groups[g].begin(), groups[g].end());
+            load[w] += group_size[g];
+        }
+        shards = groups.size();
+
+        run_workers(workers, [&](unsigned w) {
+            label_from(assignment[w], [](idx_type) { return true; });
+        });
+
+        const auto n = hpd.n;
+        run_workers(workers, [&](unsigned w) {
+            const auto label = [&](idx_type u) { return read_label(u); };
+            const auto first = n * w / workers;
+            const auto last = n * (w + 1) / workers;
+            for (idx_type v = first; v < last; v++) {
+                const auto [x, y] = embedding_type::point(tree, hpd, v, label);
+                points[v] = point_record{x, y};
+            }
+        });
+    }
+
+    ShardedDyadicTreeMetricEmbedding(const ShardedDyadicTreeMetricEmbedding &)
+        = delete;
+    auto operator=(const ShardedDyadicTreeMetricEmbedding &)
+        -> ShardedDyadicTreeMetricEmbedding & = delete;
+
+    auto embedding() const -> embedding_map {
+        embedding_map e(hpd.n);
+        for (idx_type v = 0; v < hpd.n; v++) {
+            e[v] = std::make_pair(points[v].x, points[v].y);
+        }
+        return e;
+    }
+
+    auto label(idx_type v) const -> std::pair<bitpath, int> {
+        return read_label(v);
+    }
+
+    auto label_count() const -> idx_type { return tree.size(); }
+
+    // number of shards (groups of shard roots) handed out to the workers.
+    auto shard_count() const -> idx_type { return shards; }
+
+private:
+    // Unmapped on destruction, including when the constructor throws.
+    struct file_mapping {
+        void *data = MAP_FAILED;
+        std::size_t size = 0;
+
+        file_mapping() = default;
+        file_mapping(const file_mapping &) = delete;
+        auto operator=(const file_mapping &) -> file_mapping & = delete;
+        ~file_mapping() {
+            if (data != MAP_FAILED) {
+                munmap(data, size);
+            }
+        }
+    };
+
+    tree_type tree;
+    HeavyPathDecomposition hpd;
+    idx_type shards = 0;
+    file_mapping mapping;
+    label_record *labels = nullptr;
+    point_record *points = nullptr;
+
+    static auto align(std::size_t offset) -> std::size_t {
+        constexpr std::size_t alignment = 64;
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    void map_label_file(const std::string &label_file) {
+        const auto labels_offset = align(sizeof(file_header));
+        const auto points_offset =
+            align(labels_offset + tree.size() * sizeof(label_record));
+        const auto mapping_size = points_offset + hpd.n * sizeof(point_record);
+
+        const int fd = open(label_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), label_file);
+        }
+        if (ftruncate(fd, mapping_size) != 0) {
+            const auto error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), label_file);
+        }
+        mapping.data = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+        const auto error = errno;
+        close(fd);
+        if (mapping.data == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), label_file);
+        }
+        mapping.size = mapping_size;
+
+        auto *bytes = static_cast<char *>(mapping.data);
+        file_header header{{'S', 'G', 'E', 'M', 'B', 'E', 'D', '1'},
+            hpd.n, tree.size(), sizeof(Float)};
+        std::memcpy(bytes, &header, sizeof(header));
+        labels = reinterpret_cast<label_record *>(bytes + labels_offset);
+        points = reinterpret_cast<point_record *>(bytes + points_offset);
+    }
+
+    void write_label(idx_type v, const std::pair<bitpath, int> &label) {
+        const bitpath low_mask(~0ULL);
+        labels[v] = label_record{(label.first >> 64).to_ullong(),
+            (label.first & low_mask).to_ullong(), label.second};
+    }
+
+    auto read_label(idx_type v) const -> std::pair<bitpath, int> {
+        const auto &r = labels[v];
+        return std::make_pair(
+            (bitpath(r.high) << 64) | bitpath(r.low), int(r.depth));
+    }
+
+    // Label the heavy paths reachable from the given (already labeled) heads,
+    // descending into a light child only if expand(c).
+    template <class Expand>
+    void label_from(const std::vector<idx_type> &heads, Expand &&expand) {
+        constexpr auto no_child = HeavyPathDecomposition::no_child;
+        std::vector<idx_type> stack(heads.rbegin(), heads.rend());
+
+        while (!stack.empty()) {
+            const auto s = stack.back();
+            stack.pop_back();
+
+            std::vector<idx_type> segment;
+            for (auto v = s; v != no_child; v = hpd.heavy[v]) {
+                segment.push_back(v);
+            }
+            const auto [s_path, s_depth] = read_label(s);
+            const auto wbt = embedding_type::build_super_node(tree, hpd, segment);
+            embedding_type::label_light_children(wbt, s_path, s_depth,
+                [&](idx_type c, const bitpath &path, int depth) {
+                    write_label(c,
+                        embedding_type::head_label(hpd, c, path, depth));
+                    if (expand(c)) {
+                        stack.push_back(c);
+                    }
+                });
+        }
+    }
+
+    // fork one process per worker, run job(w) in it and wait for all of them.
+    template <class Job>
+    void run_workers(unsigned workers, const Job &job) {
+        std::vector<pid_t> pids;
+        pids.reserve(workers);
+        for (unsigned w = 0; w < workers; w++) {
+            const auto pid = fork();
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    job(w);
+                } catch (...) {
+                    status = 1;
+                }
+                _exit(status);
+            }
+            if (pid < 0) {
+                const auto error = errno;
+                for (const auto p : pids) {
+                    waitpid(p, nullptr, 0);
+                }
+                throw std::system_error(error, std::generic_category(), "fork");
+            }
+            pids.push_back(pid);
+        }
+
+        bool failed = false;
+        for (const auto pid : pids) {
+            int status = 0;
+            if (waitpid(pid, &status, 0) != pid
+                || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            throw std::runtime_error("sharded embedding worker failed");
+        }
+    }
+};
+
+#endif // LIB_SHARDED_EMBEDDING_HH
@@ -0,0 +1,190 @@
+#ifndef LIB_SNAPSHOT_DIFF_PIPELINE_HH
+#define LIB_SNAPSHOT_DIFF_PIPELINE_HH
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <tuple>
+#include <vector>
+
+#include "dyadic_tree_metric_embedding.hh"
+
+// Re-embeds consecutive snapshots of a tree and streams only the heavy path
+// labels that changed since the previous snapshot.
+//
+// Each snapshot is embedded from the previous DyadicTreeMetricEmbedding, so
+// unchanged subtrees keep their labels, coordinates and weight balanced
+// trees. The heavy path decomposition itself is recomputed, it is one linear
+// pass and it is what tells which heavy paths changed.
+//
+// The coordinates of every vertex follow from the labels of heavy path heads
+// (DyadicTreeMetricEmbedding::point), so the stream carries labels: one per
+// heavy path instead of one per vertex, in 26 bytes instead of 8 + 2 Floats.
+// Every snapshot is written as one frame, in host byte order:
+//   u32 magic, u32 path_length, u64 snapshot, u64 label_count, u64 entries
+//   entries x (u64 vertex, u64 high bits, u64 low bits, u16 depth)
+// Only heads are sent, including the dummy leaves (vertices >= the tree
+// size), and labels at or past label_count no longer exist.
+template <class Float>
+class SnapshotDiffPipeline {
+public:
+    using embedding_type = DyadicTreeMetricEmbedding<Float>;
+    using idx_type = typename embedding_type::idx_type;
+    using tree_type = typename embedding_type::tree_type;
+    using bitpath = typename embedding_type::bitpath;
+    using label_type = std::pair<bitpath, int>;
+    static constexpr std::uint32_t magic = 0x32444753; // "SGD2".
+
+    struct snapshot_stats {
+        idx_type snapshot;
+        idx_type vertices;
+        idx_type changed;
+        idx_type delta_bytes;
+        idx_type super_nodes;
+        idx_type reused_super_nodes;
+        idx_type recomputed_points;
+        std::chrono::nanoseconds latency;
+    };
+
+    struct frame {
+        idx_type snapshot;
+        idx_type label_count;
+        std::vector<std::tuple<idx_type, bitpath, int>> entries;
+    };
+
+    explicit SnapshotDiffPipeline(std::ostream &delta_stream)
+        : out{delta_stream} {}
+
+    // Embeds the next snapshot and writes its delta frame.
+    auto push(const tree_type &tree) -> snapshot_stats {
+        const auto start = std::chrono::steady_clock::now();
+
+        auto next = previous
+            ? embedding_type(tree, std::move(*previous))
+            : embedding_type(tree);
+
+        // Non heads keep no label, so a vertex that becomes a head again is
+        // always sent.
+        const auto &hpd = next.decomposition();
+        const auto &labels = next.labels();
+        std::vector<label_type> heads(labels.size(), label_type{0, -1});
+        std::vector<idx_type> changed;
+        for (idx_type v = 0; v < labels.size(); v++) {
+            if (v < hpd.n && hpd.head[v] != v) { continue; }
+            heads[v] = labels[v];
+            if (v >= previous_labels.size() || previous_labels[v] != heads[v]) {
+                changed.push_back(v);
+            }
+        }
+
+        const auto bytes = write_frame(heads, changed);
+        const snapshot_stats stats{
+            snapshot,
+            hpd.n,
+            changed.size(),
+            bytes,
+            next.super_nodes().size(),
+            next.reused(),
+            next.recomputed(),
+            std::chrono::steady_clock::now() - start,
+        };
+
+        previous.emplace(std::move(next));
+        previous_labels = std::move(heads);
+        snapshot++;
+        return stats;
+    }
+
+    // Pulls snapshots from read(tree) until it returns false. The next
+    // snapshot is read on another thread while the current one is diffed.
+    template <class Reader>
+    auto run(Reader &&read) -> std::vector<snapshot_stats> {
+        std::vector<snapshot_stats> stats;
+        tree_type current;
+        if (!read(current)) {
+            return stats;
+        }
+
+        while (true) {
+            tree_type upcoming;
+            auto reading = std::async(std::launch::async,
+                [&]() -> bool { return read(upcoming); });
+            stats.push_back(push(current));
+            if (!reading.get()) {
+                break;
+            }
+            current.swap(upcoming);
+        }
+        return stats;
+    }
+
+    // Reads one frame written by the pipeline, false at the end of the stream.
+    static auto read_frame(std::istream &in, frame &f) -> bool {
+        std::uint32_t header[2];
+        std::uint64_t counts[3];
+        if (!in.read(reinterpret_cast<char *>(header), sizeof(header))
+            || !in.read(reinterpret_cast<char *>(counts), sizeof(counts))
+            || header[0] != magic || header[1] != embedding_type::path_length) {
+            return false;
+        }
+
+        f.snapshot = counts[0];
+        f.label_count = counts[1];
+        f.entries.resize(counts[2]);
+        for (auto &[vertex, path, depth] : f.entries) {
+            std::uint64_t words[3];
+            std::uint16_t d;
+            in.read(reinterpret_cast<char *>(words), sizeof(words));
+            in.read(reinterpret_cast<char *>(&d), sizeof(d));
+            vertex = words[0];
+            path = (bitpath(words[1]) << 64) | bitpath(words[2]);
+            depth = d;
+        }
+        return bool(in);
+    }
+
+private:
+    std::ostream &out;
+    std::optional<embedding_type> previous;
+    std::vector<label_type> previous_labels;
+    idx_type snapshot = 0;
+
+    static constexpr auto entry_size =
+        3 * sizeof(std::uint64_t) + sizeof(std::uint16_t);
+
+    auto write_frame(const std::vector<label_type> &heads,
+        const std::vector<idx_type> &changed) -> idx_type {
+        std::vector<char> buffer(
+            2 * sizeof(std::uint32_t) + 3 * sizeof(std::uint64_t)
+            + changed.size() * entry_size);
+        auto *it = buffer.data();
+        const auto put = [&](const auto &value) {
+            std::memcpy(it, &value, sizeof(value));
+            it += sizeof(value);
+        };
+
+        const bitpath low_mask(~0ULL);
+        put(magic);
+        put(std::uint32_t(embedding_type::path_length));
+        put(std::uint64_t(snapshot));
+        put(std::uint64_t(heads.size()));
+        put(std::uint64_t(changed.size()));
+        for (const auto v : changed) {
+            const auto &[path, depth] = heads[v];
+            put(std::uint64_t(v));
+            put(std::uint64_t((path >> 64).to_ullong()));
+            put(std::uint64_t((path & low_mask).to_ullong()));
+            put(std::uint16_t(depth));
+        }
+
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        return buffer.size();
+    }
+};
+
+#endif // LIB_SNAPSHOT_DIFF_PIPELINE_HH
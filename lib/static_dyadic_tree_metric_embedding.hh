@@ -0,0 +1,470 @@
+#ifndef LIB_STATIC_DYADIC_TREE_EMBEDDING_HH
+#define LIB_STATIC_DYADIC_TREE_EMBEDDING_HH
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// constexpr version of DyadicTreeMetricEmbedding for small topologies that
+// are known at build time. std::bitset, std::vector and std::map are not
+// usable in constant expressions, so the same steps (heavy path
+// decomposition, dummy leaves, weight balanced trees, labels and points) are
+// done over fixed capacity arrays and 128 bit labels split into two words.
+// The result is identical to DyadicTreeMetricEmbedding, and a constexpr
+// instance bakes the labels and coordinates into the binary.
+//
+// Compilers bound the work of a constant expression (-fconstexpr-ops-limit,
+// -fconstexpr-steps), so the construction is kept lean: the working arrays
+// are plain arrays, as every std::array::operator[] is a call when evaluated
+// at compile time, the weight balanced tree split is a binary search like the
+// run time one and the LUT takes its exact leading terms in one step. A 300
+// vertex tree takes about 550k gcc operations.
+//
+// The tree is given as parent[v] (parent[0] == 0 for the root). The children
+// of a vertex are taken in increasing index order.
+template <class Float, std::size_t N>
+class StaticDyadicTreeMetricEmbedding {
+public:
+    using idx_type = std::size_t;
+    using parent_array = std::array<idx_type, N>;
+    static constexpr int path_length = 128;
+    static constexpr idx_type no_child = ~idx_type{0};
+    // the tree plus at most one dummy leaf per vertex.
+    static constexpr idx_type capacity = 2 * N;
+
+    struct label {
+        std::uint64_t high;
+        std::uint64_t low;
+        int depth;
+    };
+
+    struct point {
+        Float x;
+        Float y;
+    };
+
+    constexpr explicit StaticDyadicTreeMetricEmbedding(const parent_array &p)
+        : parent{p} {
+        for (idx_type v = 0; v < N; v++) {
+            first_child[v] = no_child;
+            next_sibling[v] = no_child;
+        }
+        for (idx_type v = N; v-- > 1;) {
+            next_sibling[v] = first_child[parent[v]];
+            first_child[parent[v]] = v;
+        }
+
+        topology t{};
+        t.build(parent);
+        vertices = t.fix_heavy_path_children();
+        label_super_nodes(t);
+        for (idx_type v = 0; v < N; v++) {
+            points[v] = compute_point(t, v);
+            heads[v] = t.head[v];
+            fs[v] = compute_f(t, v);
+        }
+    }
+
+    // DyadicTreeMetricKernel over the labels of this embedding: x is the
+    // label of the head of v, y the lowest common ancestor of the labels of
+    // its light children. Evaluated on vertex indices.
+    struct metric_kernel {
+        const StaticDyadicTreeMetricEmbedding *embedding;
+
+        constexpr void operator()(idx_type s, const idx_type *targets,
+            std::size_t count, Float *out) const {
+            const auto &xs = embedding->labels;
+            const auto &heads = embedding->heads;
+            const auto &fs = embedding->fs;
+            for (std::size_t i = 0; i < count; i++) {
+                const auto t = targets[i];
+                const auto &xs_s = xs[heads[s]];
+                const auto &xs_t = xs[heads[t]];
+                const auto common = std::min({
+                    common_prefix(xs_s, xs_t), xs_s.depth, xs_t.depth});
+                const auto dy = fs[t] - fs[s];
+                out[i] = Float(xs_s.depth + xs_t.depth - 2 * common)
+                    + (dy < 0 ? -dy : dy);
+            }
+        }
+    };
+
+    constexpr auto kernel() const -> metric_kernel {
+        return metric_kernel{this};
+    }
+
+    constexpr auto embedding() const -> const std::array<point, N> & {
+        return points;
+    }
+
+    // label of the heavy path headed by v (dummy leaves are >= N).
+    constexpr auto label_of(idx_type v) const -> const label & {
+        return labels[v];
+    }
+
+    // number of labeled vertices, dummy leaves included.
+    constexpr auto label_count() const -> idx_type { return vertices; }
+
+    // Number of ordered pairs (s, t) for which no tree neighbor of s is
+    // strictly closer to t than s, using kernel() or one of the coordinate
+    // kernels of greedy_property_verifier.hh (they are constexpr).
+    template <class Kernel>
+    constexpr auto greedy_violations(Kernel kernel) const -> idx_type {
+        // Kernels take either the coordinates or the vertex indices.
+        const auto distance = [&](idx_type u, idx_type t) {
+            Float d{};
+            if constexpr (std::is_invocable_v<const Kernel &, idx_type,
+                const idx_type *, std::size_t, Float *>) {
+                kernel(u, &t, 1, &d);
+            } else {
+                kernel(points[u].x, points[u].y,
+                    &points[t].x, &points[t].y, 1, &d);
+            }
+            return d;
+        };
+
+        idx_type violations = 0;
+        for (idx_type s = 0; s < N; s++) {
+            for (idx_type t = 0; t < N; t++) {
+                if (s == t) { continue; }
+                const auto ds = distance(s, t);
+
+                bool greedy = false;
+                const auto closer = [&](idx_type u) {
+                    return distance(u, t) < ds;
+                };
+                if (s != 0) {
+                    greedy = closer(parent[s]);
+                }
+                for (auto c = first_child[s]; !greedy && c != no_child;
+                    c = next_sibling[c]) {
+                    greedy = closer(c);
+                }
+                violations += !greedy;
+            }
+        }
+        return violations;
+    }
+
+private:
+    parent_array parent{};
+    idx_type first_child[N]{}; // NOLINT.
+    idx_type next_sibling[N]{}; // NOLINT.
+    label labels[capacity]{}; // NOLINT.
+    std::array<point, N> points{};
+    idx_type heads[N]{}; // NOLINT.
+    Float fs[N]{}; // NOLINT: f(y) of the dyadic tree metric.
+    idx_type vertices{};
+
+    // Working storage of the construction, it does not end up in the object.
+    struct topology {
+        idx_type parent[capacity]{}; // NOLINT.
+        idx_type first_child[capacity]{}; // NOLINT.
+        idx_type last_child[capacity]{}; // NOLINT.
+        idx_type next_sibling[capacity]{}; // NOLINT.
+        idx_type child_count[capacity]{}; // NOLINT.
+        idx_type heavy[capacity]{}; // NOLINT.
+        idx_type head[capacity]{}; // NOLINT.
+        idx_type depth[capacity]{}; // NOLINT.
+        idx_type subtree_size[capacity]{}; // NOLINT.
+        idx_type size{};
+
+        constexpr void add_child(idx_type v, idx_type c) {
+            parent[c] = v;
+            if (last_child[v] == no_child) {
+                first_child[v] = c;
+            } else {
+                next_sibling[last_child[v]] = c;
+            }
+            last_child[v] = c;
+            child_count[v]++;
+        }
+
+        // Same decomposition as HeavyPathDecomposition.
+        constexpr void build(const parent_array &p) {
+            size = N;
+            for (idx_type v = 0; v < capacity; v++) {
+                first_child[v] = no_child;
+                last_child[v] = no_child;
+                next_sibling[v] = no_child;
+            }
+            for (idx_type v = 1; v < N; v++) {
+                add_child(p[v], v);
+            }
+
+            idx_type order[N]{}; // NOLINT.
+            idx_type stack[N]{}; // NOLINT.
+            idx_type visited = 0;
+            idx_type top = 0;
+            stack[top++] = 0;
+            depth[0] = 0;
+            while (top > 0) {
+                const auto v = stack[--top];
+                order[visited++] = v;
+                for (auto c = first_child[v]; c != no_child; c = next_sibling[c]) {
+                    depth[c] = depth[v] + 1;
+                    stack[top++] = c;
+                }
+            }
+
+            for (idx_type i = N; i-- > 0;) {
+                const auto v = order[i];
+                subtree_size[v] = 1;
+                heavy[v] = no_child;
+                idx_type max_subtree_size = 0;
+                for (auto c = first_child[v]; c != no_child; c = next_sibling[c]) {
+                    subtree_size[v] += subtree_size[c];
+                    if (subtree_size[c] > max_subtree_size) {
+                        max_subtree_size = subtree_size[c];
+                        heavy[v] = c;
+                    }
+                }
+            }
+
+            head[0] = 0;
+            for (idx_type i = 0; i < N; i++) {
+                const auto v = order[i];
+                for (auto c = first_child[v]; c != no_child; c = next_sibling[c]) {
+                    head[c] = c == heavy[v] ? head[v] : c;
+                }
+            }
+        }
+
+        // Same dummy leaves as DyadicTreeMetricEmbedding, returns the number
+        // of vertices including them.
+        constexpr auto fix_heavy_path_children() -> idx_type {
+            bool is_head[N]{}; // NOLINT.
+            for (idx_type v = 0; v < N; v++) {
+                is_head[head[v]] = true;
+            }
+
+            for (idx_type path_root = 0; path_root < N; path_root++) {
+                if (!is_head[path_root]) { continue; }
+
+                auto it = path_root;
+                do {
+                    if (child_count[it] == 1 ||
+                        (child_count[it] == 0 && it != head[it])) {
+                        const auto dummy = size++;
+                        add_child(it, dummy);
+                        heavy[dummy] = no_child;
+                        head[dummy] = dummy;
+                        depth[dummy] = depth[it] + 1;
+                        subtree_size[dummy] = 1;
+                    }
+                } while ((it = heavy[it]) != no_child);
+            }
+
+            return size;
+        }
+    };
+
+    struct fractions {
+        long double t[path_length]; // NOLINT.
+        constexpr fractions() : t{0.5} {
+            for (int i = 1; i < path_length; i++) {
+                t[i] = t[i-1] / 2;
+            }
+        }
+    };
+    static constexpr fractions lut_fractions{};
+
+    static constexpr auto bit(const label &l, int i) -> int {
+        return i >= 64 ? (l.high >> (i - 64)) & 1 : (l.low >> i) & 1;
+    }
+
+    // Same sum as the run time LUT, evaluated in far fewer steps. The first
+    // partial sums need at most one bit more than the bits read so far, so
+    // they are exact in Float and are taken in one go as (2b + 1) / 2^(m+1)
+    // for the m leading bits b. The loop stops once neither sign of the next
+    // term changes the total, the smaller terms after it cannot either.
+    static constexpr auto lut(const label &l, int depth) -> Float {
+        const auto terms = depth - 1;
+        if (terms <= 0) {
+            return Float{0.5};
+        }
+
+        constexpr int exact = std::min(std::numeric_limits<Float>::digits, 64) - 1;
+        const auto m = std::min(terms, exact);
+        const auto b = (l.high >> (63 - m)) & ((std::uint64_t(1) << m) - 1);
+        Float total = Float(2*b + 1) * lut_fractions.t[m];
+
+        for (int i = path_length-1 - m; i > path_length - depth; i--) {
+            const auto term = lut_fractions.t[path_length - i];
+            if (Float(total + term) == total && Float(total - term) == total) {
+                break;
+            }
+            total += (-1 + 2*bit(l, i-1))*term;
+        }
+        return total;
+    }
+
+    // __builtin_ffsll is usable in constant expressions with gcc and clang.
+    static constexpr auto ffs64(std::uint64_t bits) -> int {
+        return __builtin_ffsll(static_cast<long long>(bits));
+    }
+
+    // Leading bits (from bit 126 down) the two labels share.
+    static constexpr auto common_prefix(const label &lhs, const label &rhs)
+        -> int {
+        const auto high = lhs.high ^ rhs.high;
+        const auto low = lhs.low ^ rhs.low;
+        if (high != 0) {
+            return __builtin_clzll(high) - 1;
+        }
+        if (low != 0) {
+            return 63 + __builtin_clzll(low);
+        }
+        return std::numeric_limits<int>::max();
+    }
+
+    // DyadicTreeMetricEmbedding::ffs on the two words.
+    static constexpr auto ffs(std::uint64_t high, std::uint64_t low) -> int {
+        int fs = 0;
+        fs = std::max(path_length * bool(low) + ffs64(low), fs);
+        fs = std::max(path_length / 2 * bool(high) + ffs64(high), fs);
+        return fs;
+    }
+
+    constexpr void set_label(const topology &t, idx_type s, label l) {
+        if (t.subtree_size[s] == 1) {
+            l.depth += l.depth;
+        }
+        labels[s] = l;
+    }
+
+    // DyadicTreeMetricEmbedding::dfs_and_compute_point_embedding.
+    constexpr void label_super_nodes(const topology &t) {
+        struct wbt_node {
+            idx_type l;
+            idx_type r;
+            label path;
+        };
+
+        idx_type stack[capacity]{}; // NOLINT.
+        idx_type leaves[capacity]{}; // NOLINT.
+        idx_type prefix_sum[capacity + 1]{}; // NOLINT.
+        wbt_node wbt_stack[capacity + 1]{}; // NOLINT.
+        idx_type top = 0;
+
+        set_label(t, 0, label{0, 0, 0});
+        stack[top++] = 0;
+        while (top > 0) {
+            const auto s = stack[--top];
+
+            idx_type m = 0;
+            for (auto v = s; v != no_child; v = t.heavy[v]) {
+                for (auto c = t.first_child[v]; c != no_child;
+                    c = t.next_sibling[c]) {
+                    if (c == t.heavy[v]) { continue; }
+                    leaves[m] = c;
+                    prefix_sum[m + 1] = prefix_sum[m] + t.subtree_size[c];
+                    m++;
+                }
+            }
+
+            // AutocraticWeightBalancedTree split, walked as it is built.
+            idx_type wbt_top = 0;
+            wbt_stack[wbt_top++] = wbt_node{0, m, labels[s]};
+            while (wbt_top > 0) {
+                const auto node = wbt_stack[--wbt_top];
+                const auto l = node.l;
+                const auto r = node.r;
+                auto path = node.path;
+
+                if ((l + 1) == r) {
+                    path.depth++;
+                    set_label(t, leaves[l], path);
+                    stack[top++] = leaves[l];
+                }
+                if ((r - l) <= 1) {
+                    continue;
+                }
+
+                const auto total = prefix_sum[r] - prefix_sum[l];
+                // lower_bound over prefix_sum[l+1, r] as in the run time split.
+                auto i = l + 1;
+                auto last = r + 1;
+                while (i < last) {
+                    const auto mid = i + (last - i) / 2;
+                    if (2*(prefix_sum[mid] - prefix_sum[l]) < total) {
+                        i = mid + 1;
+                    } else {
+                        last = mid;
+                    }
+                }
+                const auto dist = (r - l) == 2 ? 1 : i >= r ? r - l - 1 : i - l;
+
+                auto left = path;
+                left.depth++;
+                auto right = left;
+                const auto next_bit = (path_length - 1) - left.depth;
+                if (next_bit >= 64) {
+                    right.high |= std::uint64_t(1) << (next_bit - 64);
+                } else {
+                    right.low |= std::uint64_t(1) << next_bit;
+                }
+                // pushed in the same order as the run time walk.
+                wbt_stack[wbt_top++] = wbt_node{l, l + dist, left};
+                wbt_stack[wbt_top++] = wbt_node{l + dist, r, right};
+            }
+        }
+    }
+
+    // DyadicTreeMetricEmbedding::point.
+    constexpr auto compute_point(const topology &t, idx_type v) const -> point {
+        const auto x = lut(labels[t.head[v]], labels[t.head[v]].depth);
+        if (t.child_count[v] == 0) {
+            return point{x, x};
+        }
+
+        idx_type light = 0;
+        label first{};
+        int curr_lca = path_length;
+        label u{0, 0, 0};
+        for (auto c = t.first_child[v]; c != no_child; c = t.next_sibling[c]) {
+            if (c == t.heavy[v]) { continue; }
+            const auto &l = labels[c];
+            if (light++ == 0) {
+                first = l;
+            }
+            const auto lca = ffs(u.high ^ l.high, u.low ^ l.low);
+            if (lca < curr_lca) {
+                curr_lca = lca;
+                u = l;
+            }
+        }
+
+        if (light == 1) {
+            return point{x, lut(first, first.depth)};
+        }
+        return point{x, lut(first, curr_lca)};
+    }
+
+    // f(y) of DyadicTreeMetricKernel: f(root) = 1/2 and the children of a
+    // node at level i are at -/+ 2^(-i-2).
+    constexpr auto compute_f(const topology &t, idx_type v) const -> Float {
+        label y = labels[t.head[v]];
+        bool leaf = true;
+        for (auto c = t.first_child[v]; c != no_child; c = t.next_sibling[c]) {
+            if (c == t.heavy[v]) { continue; }
+            if (leaf) {
+                y = labels[c];
+                leaf = false;
+            } else {
+                y.depth = std::min(y.depth, common_prefix(y, labels[c]));
+            }
+        }
+
+        Float value = 0.5;
+        Float step = 0.25;
+        for (int k = 0; k < y.depth; k++, step /= 2) {
+            value += bit(y, path_length - 2 - k) ? step : -step;
+        }
+        return value;
+    }
+};
+
+#endif // LIB_STATIC_DYADIC_TREE_EMBEDDING_HH
@@ -0,0 +1,118 @@
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "lib/greedy_forwarding_table.hh"
+
+namespace {
+
+using Fp = long double;
+using dtme_type = DyadicTreeMetricEmbedding<Fp>;
+using tables_type = GreedyForwardingTables<Fp>;
+
+auto tree_distance(const HeavyPathDecomposition &hpd,
+    std::size_t u, std::size_t v) -> std::size_t {
+    std::size_t distance = 0;
+    while (u != v) {
+        if (hpd.depth[u] < hpd.depth[v]) {
+            std::swap(u, v);
+        }
+        u = hpd.parent[u];
+        distance++;
+    }
+    return distance;
+}
+
+// Route between every pair of vertices and check that every packet arrives
+// along the tree path.
+void expect_routes(const dtme_type &dtme, const tables_type &tables) {
+    const auto &hpd = dtme.decomposition();
+    for (std::size_t s = 0; s < hpd.n; s++) {
+        for (std::size_t t = 0; t < hpd.n; t++) {
+            const auto target = tables.address_of(t);
+            std::size_t v = s;
+            std::size_t hops = 0;
+            for (std::size_t next; (next = tables.next_hop(v, target)) != v;) {
+                ASSERT_LT(next, hpd.n) << "s = " << s << ", t = " << t;
+                ASSERT_TRUE(hpd.parent[next] == v || hpd.parent[v] == next);
+                ASSERT_LE(++hops, hpd.n);
+                v = next;
+            }
+            EXPECT_EQ(v, t);
+            EXPECT_EQ(hops, tree_distance(hpd, s, t));
+        }
+    }
+}
+
+auto random_tree(std::size_t n, unsigned seed) -> dtme_type::tree_type {
+    std::mt19937 rng(seed);
+    dtme_type::tree_type tree(n);
+    for (std::size_t v = 1; v < n; v++) {
+        std::uniform_int_distribution<std::size_t> parent(0, v - 1);
+        tree[parent(rng)].push_back(v);
+    }
+    return tree;
+}
+
+} // namespace
+
+TEST(greedy_forwarding_table, route) {
+    enum v {
+        a = 0,
+        b,
+        c,
+        d,
+        e,
+        f,
+        g,
+        h,
+        i,
+        j,
+        k,
+    };
+    dtme_type::tree_type tree{
+        {b, c, d, k}, // a root.
+        {}, // b leaf.
+        {}, // c leaf.
+        {e}, // d.
+        {f}, // e.
+        {}, // f.
+        {}, // g.
+        {g}, // h.
+        {h}, // i.
+        {}, // j.
+        {i, j}, // k.
+    };
+
+    dtme_type dtme(tree);
+    tables_type tables(dtme, 2);
+    expect_routes(dtme, tables);
+
+    // a only splits out its light children b, c and d.
+    EXPECT_EQ(tables.table(a).next_hops.size(), 5);
+    // k has the single light child j.
+    EXPECT_EQ(tables.table(k).next_hops.size(), 4);
+
+    const auto stats = tables.stats();
+    EXPECT_EQ(stats.tables, tree.size());
+    EXPECT_EQ(stats.max_entries, 5);
+}
+
+TEST(greedy_forwarding_table, route_random_tree) {
+    const auto tree = random_tree(400, 26);
+    for (const auto order : {
+            dtme_type::vertex_order::original,
+            dtme_type::vertex_order::heavy_path_position}) {
+        dtme_type dtme(tree, order);
+        tables_type tables(dtme, 4);
+        expect_routes(dtme, tables);
+
+        // One interval per light child plus at most the parent, heavy child,
+        // same path and outside-of-path intervals.
+        const auto &adj = dtme.adjacency();
+        for (std::size_t v = 0; v < tree.size(); v++) {
+            EXPECT_LE(tables.table(v).prefixes.size(), adj[v].size() + 4);
+        }
+    }
+}
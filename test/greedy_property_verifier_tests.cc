@@ -0,0 +1,192 @@
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "lib/greedy_property_verifier.hh"
+
+namespace {
+
+using Fp = double;
+using verifier_type = GreedyPropertyVerifier<Fp>;
+
+// Path 0 - 1 - ... - (n-1) laid out in order on the x axis.
+auto path_tree(std::size_t n) -> verifier_type::tree_type {
+    verifier_type::tree_type tree(n);
+    for (std::size_t v = 0; v + 1 < n; v++) {
+        tree[v].push_back(v + 1);
+    }
+    return tree;
+}
+
+auto path_points(std::size_t n) -> verifier_type::embedding_map {
+    verifier_type::embedding_map points(n);
+    for (std::size_t v = 0; v < n; v++) {
+        points[v] = std::make_pair(Fp(v), Fp(1));
+    }
+    return points;
+}
+
+} // namespace
+
+TEST(greedy_property_verifier, greedy_path) {
+    const std::size_t n = 64;
+    verifier_type verifier(path_points(n), path_tree(n),
+        std::vector<int>(n, 0));
+
+    const auto exhaustive = verifier.verify(SquaredEuclideanKernel<Fp>{}, n);
+    EXPECT_EQ(exhaustive.checked_pairs, n * (n - 1));
+    EXPECT_EQ(exhaustive.violating_pairs, 0);
+    EXPECT_TRUE(exhaustive.violations.empty());
+
+    const auto sampled = verifier.verify(SquaredEuclideanKernel<Fp>{}, 8, 3, 4);
+    EXPECT_GE(sampled.checked_pairs, n * 7);
+    EXPECT_LE(sampled.checked_pairs, n * 8);
+    EXPECT_EQ(sampled.violating_pairs, 0);
+}
+
+TEST(greedy_property_verifier, swapped_vertices) {
+    const std::size_t n = 8;
+    auto points = path_points(n);
+    std::swap(points[3], points[5]);
+    std::vector<int> depths{0, 1, 2, 3, 4, 5, 6, 7};
+    verifier_type verifier(points, path_tree(n), depths);
+
+    // Brute force the expected violations.
+    std::set<std::pair<std::size_t, std::size_t>> expected;
+    const auto distance = [&](std::size_t u, std::size_t v) {
+        const auto dx = points[u].first - points[v].first;
+        return dx * dx;
+    };
+    for (std::size_t s = 0; s < n; s++) {
+        for (std::size_t t = 0; t < n; t++) {
+            if (s == t) { continue; }
+            bool greedy = false;
+            for (const auto u : {s - 1, s + 1}) {
+                if (u < n && distance(u, t) < distance(s, t)) {
+                    greedy = true;
+                }
+            }
+            if (!greedy) {
+                expected.emplace(s, t);
+            }
+        }
+    }
+    ASSERT_FALSE(expected.empty());
+
+    const auto result = verifier.verify(SquaredEuclideanKernel<Fp>{}, n, 0, 3);
+    EXPECT_EQ(result.violating_pairs, expected.size());
+    std::set<std::pair<std::size_t, std::size_t>> found;
+    for (const auto &violation : result.violations) {
+        found.emplace(violation.source, violation.target);
+        EXPECT_EQ(violation.source_depth, depths[violation.source]);
+        EXPECT_EQ(violation.target_depth, depths[violation.target]);
+    }
+    EXPECT_EQ(found, expected);
+
+    const auto capped = verifier.verify(SquaredEuclideanKernel<Fp>{}, n, 0, 3, 2);
+    EXPECT_EQ(capped.violating_pairs, expected.size());
+    ASSERT_EQ(capped.violations.size(), 2);
+    EXPECT_EQ(capped.violations[0].source, expected.begin()->first);
+    EXPECT_EQ(capped.violations[0].target, expected.begin()->second);
+}
+
+TEST(greedy_property_verifier, dyadic_tree_metric_greedy) {
+    // Path 0 - 1 - ... with a leaf hanging off every spine vertex.
+    const std::size_t n = 301;
+    DyadicTreeMetricEmbedding<Fp>::tree_type caterpillar(n);
+    for (std::size_t v = 1; v < n; v++) {
+        caterpillar[v % 2 ? (v > 1 ? v - 2 : 0) : v - 1].push_back(v);
+    }
+
+    for (const auto &tree : {path_tree(n), caterpillar}) {
+        DyadicTreeMetricEmbedding<Fp> dtme(tree);
+        verifier_type verifier(dtme);
+        const DyadicTreeMetricKernel<Fp> kernel(dtme);
+
+        const auto result = verifier.verify(kernel, n, 0, 4);
+        EXPECT_EQ(result.checked_pairs, n * (n - 1));
+        EXPECT_EQ(result.violating_pairs, 0);
+        EXPECT_TRUE(result.violations.empty());
+    }
+}
+
+TEST(greedy_property_verifier, dyadic_tree_metric_brute_force) {
+    std::mt19937 rng(28);
+    DyadicTreeMetricEmbedding<Fp>::tree_type tree(300);
+    for (std::size_t v = 1; v < tree.size(); v++) {
+        tree[std::uniform_int_distribution<std::size_t>(0, v - 1)(rng)]
+            .push_back(v);
+    }
+    DyadicTreeMetricEmbedding<Fp> dtme(tree);
+    verifier_type verifier(dtme);
+    const DyadicTreeMetricKernel<Fp> kernel(dtme);
+
+    // Brute force distances straight from the labels, bit by bit.
+    const auto &hpd = dtme.decomposition();
+    using label_type = std::pair<DyadicTreeMetricEmbedding<Fp>::bitpath, int>;
+    const auto common_prefix = [](const label_type &u, const label_type &v) {
+        int common = 0;
+        while (common < std::min(u.second, v.second)
+            && u.first[126 - common] == v.first[126 - common]) {
+            common++;
+        }
+        return common;
+    };
+    const auto f = [](const label_type &u) {
+        Fp value = 0.5;
+        for (int k = 0; k < u.second; k++) {
+            value += (u.first[126 - k] ? 1 : -1) * std::ldexp(Fp(1), -k - 2);
+        }
+        return value;
+    };
+    std::vector<label_type> xs(tree.size());
+    std::vector<label_type> ys(tree.size());
+    for (std::size_t v = 0; v < tree.size(); v++) {
+        xs[v] = dtme.labels()[hpd.head[v]];
+        ys[v] = xs[v];
+        bool leaf = true;
+        for (const auto c : dtme.adjacency()[v]) {
+            if (c == hpd.heavy[v]) { continue; }
+            if (leaf) {
+                ys[v] = dtme.labels()[c];
+                leaf = false;
+            } else {
+                ys[v].second = common_prefix(ys[v], dtme.labels()[c]);
+            }
+        }
+    }
+    const auto distance = [&](std::size_t u, std::size_t v) {
+        return Fp(xs[u].second + xs[v].second
+            - 2 * common_prefix(xs[u], xs[v])) + std::abs(f(ys[u]) - f(ys[v]));
+    };
+    std::set<std::pair<std::size_t, std::size_t>> expected;
+    for (std::size_t s = 0; s < tree.size(); s++) {
+        for (std::size_t t = 0; t < tree.size(); t++) {
+            if (s == t) { continue; }
+            bool greedy = false;
+            std::vector<std::size_t> adj(tree[s]);
+            if (s != 0) { adj.push_back(hpd.parent[s]); }
+            for (const auto u : adj) {
+                greedy |= distance(u, t) < distance(s, t);
+            }
+            if (!greedy) {
+                expected.emplace(s, t);
+            }
+        }
+    }
+
+    const auto result = verifier.verify(kernel, tree.size(), 0, 4,
+        tree.size() * tree.size());
+    EXPECT_EQ(result.checked_pairs, tree.size() * (tree.size() - 1));
+    EXPECT_EQ(result.violating_pairs, expected.size());
+    std::set<std::pair<std::size_t, std::size_t>> found;
+    for (const auto &violation : result.violations) {
+        found.emplace(violation.source, violation.target);
+        EXPECT_EQ(violation.source_depth, xs[violation.source].second);
+        EXPECT_EQ(violation.target_depth, xs[violation.target].second);
+    }
+    EXPECT_EQ(found, expected);
+}
@@ -125,3 +125,80 @@ TEST(heavy_path_decomposition, check_decomposition) {
     };
     EXPECT_EQ(decomposition.subtree_size, subtree_sizes);
 }
+
+TEST(heavy_path_decomposition, relabel_by_position) {
+    using hpd = HeavyPathDecomposition;
+    enum v {
+        a = 0,
+        b,
+        c,
+        d,
+        e,
+        f,
+        g,
+        h,
+        i,
+        j,
+        k,
+    };
+    hpd::tree_type tree_adj{
+        {b, c, d, k}, // a root.
+        {}, // b leaf.
+        {}, // c leaf.
+        {e}, // d.
+        {f}, // e.
+        {}, // f.
+        {}, // g.
+        {g}, // h.
+        {h}, // i.
+        {}, // j.
+        {i, j}, // k.
+    };
+
+    hpd decomposition(tree_adj);
+    const auto [permutation, inverse] =
+        decomposition.relabel_by_position(tree_adj);
+
+    const std::vector<std::size_t> original_positions{
+        0, 6, 7, 8, 9, 10, 4, 3, 2, 5, 1,
+    };
+    EXPECT_EQ(permutation, original_positions);
+    const std::vector<std::size_t> inverse_positions{
+        a, k, i, h, g, j, b, c, d, e, f,
+    };
+    EXPECT_EQ(inverse, inverse_positions);
+
+    // relabeled: a=0, k=1, i=2, h=3, g=4, j=5, b=6, c=7, d=8, e=9, f=10.
+    const hpd::tree_type relabeled_adj{
+        {6, 7, 8, 1}, // a.
+        {2, 5}, // k.
+        {3}, // i.
+        {4}, // h.
+        {}, // g.
+        {}, // j.
+        {}, // b.
+        {}, // c.
+        {9}, // d.
+        {10}, // e.
+        {}, // f.
+    };
+    EXPECT_EQ(tree_adj, relabeled_adj);
+
+    // The relabeled decomposition is the decomposition of the relabeled tree.
+    hpd expected(relabeled_adj);
+    EXPECT_EQ(decomposition.parent, expected.parent);
+    EXPECT_EQ(decomposition.depth, expected.depth);
+    EXPECT_EQ(decomposition.heavy, expected.heavy);
+    EXPECT_EQ(decomposition.head, expected.head);
+    EXPECT_EQ(decomposition.pos, expected.pos);
+    EXPECT_EQ(decomposition.subtree_size, expected.subtree_size);
+
+    const std::vector<std::size_t> heads{
+        0, 0, 0, 0, 0, // a, k, i, h, g.
+        5, // j.
+        6, // b.
+        7, // c.
+        8, 8, 8, // d, e, f.
+    };
+    EXPECT_EQ(decomposition.head, heads);
+}
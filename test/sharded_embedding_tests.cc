@@ -0,0 +1,112 @@
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <system_error>
+
+#include "gtest/gtest.h"
+
+#include "lib/sharded_embedding.hh"
+
+namespace {
+
+using Fp = long double;
+using dtme_type = DyadicTreeMetricEmbedding<Fp>;
+using sharded_type = ShardedDyadicTreeMetricEmbedding<Fp>;
+
+auto label_file(const std::string &name) -> std::string {
+    const char *dir = std::getenv("TEST_TMPDIR");
+    return std::string(dir != nullptr ? dir : "/tmp") + "/" + name;
+}
+
+void expect_same_embedding(const dtme_type::tree_type &tree, unsigned workers) {
+    dtme_type dtme(tree);
+    sharded_type sharded(tree, label_file("sharded_labels"), workers);
+
+    EXPECT_EQ(sharded.embedding(), dtme.embedding());
+    ASSERT_EQ(sharded.label_count(), dtme.labels().size());
+    for (std::size_t v = 0; v < dtme.labels().size(); v++) {
+        EXPECT_EQ(sharded.label(v), dtme.labels()[v]) << "v = " << v;
+    }
+}
+
+} // namespace
+
+TEST(sharded_embedding, embed) {
+    enum v {
+        a = 0,
+        b,
+        c,
+        d,
+        e,
+        f,
+        g,
+        h,
+        i,
+        j,
+        k,
+    };
+    dtme_type::tree_type tree{
+        {b, c, d, k}, // a root.
+        {}, // b leaf.
+        {}, // c leaf.
+        {e}, // d.
+        {f}, // e.
+        {}, // f.
+        {}, // g.
+        {g}, // h.
+        {h}, // i.
+        {}, // j.
+        {i, j}, // k.
+    };
+
+    expect_same_embedding(tree, 1);
+    expect_same_embedding(tree, 3);
+}
+
+TEST(sharded_embedding, embed_random_tree) {
+    std::mt19937 rng(29);
+    dtme_type::tree_type tree(5000);
+    for (std::size_t v = 1; v < tree.size(); v++) {
+        tree[std::uniform_int_distribution<std::size_t>(0, v - 1)(rng)]
+            .push_back(v);
+    }
+
+    expect_same_embedding(tree, 4);
+
+    sharded_type sharded(tree, label_file("sharded_labels"), 4);
+    EXPECT_GT(sharded.shard_count(), 4);
+    EXPECT_LE(sharded.shard_count(), 8 * 4 + 1);
+}
+
+TEST(sharded_embedding, shard_count_follows_workers) {
+    // Leaves only, then pairs: one light child per vertex pair.
+    dtme_type::tree_type star(50000);
+    dtme_type::tree_type pairs(50001);
+    for (std::size_t v = 1; v < star.size(); v++) {
+        star[0].push_back(v);
+    }
+    for (std::size_t v = 1; v < pairs.size(); v += 2) {
+        pairs[0].push_back(v);
+        pairs[v].push_back(v + 1);
+    }
+
+    for (const unsigned workers : {2u, 4u}) {
+        // Both are alive at once, each needs its own mapped label file.
+        sharded_type sharded_star(star, label_file("sharded_star_labels"),
+            workers);
+        EXPECT_EQ(sharded_star.shard_count(), 0);
+        EXPECT_EQ(sharded_star.embedding(), dtme_type(star).embedding());
+
+        sharded_type sharded_pairs(pairs, label_file("sharded_pairs_labels"),
+            workers);
+        EXPECT_GE(sharded_pairs.shard_count(), workers);
+        EXPECT_LE(sharded_pairs.shard_count(), 8 * workers + 1);
+        EXPECT_EQ(sharded_pairs.embedding(), dtme_type(pairs).embedding());
+    }
+}
+
+TEST(sharded_embedding, unwritable_label_file) {
+    dtme_type::tree_type tree{{1}, {}};
+    EXPECT_THROW(sharded_type(tree, "/nonexistent/sharded_labels", 2),
+        std::system_error);
+}
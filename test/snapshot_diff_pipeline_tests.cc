@@ -0,0 +1,133 @@
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "lib/snapshot_diff_pipeline.hh"
+
+namespace {
+
+using Fp = double;
+using pipeline_type = SnapshotDiffPipeline<Fp>;
+using tree_type = pipeline_type::tree_type;
+
+auto random_tree(std::size_t n, std::mt19937 &rng) -> tree_type {
+    tree_type tree(n);
+    for (std::size_t v = 1; v < n; v++) {
+        tree[std::uniform_int_distribution<std::size_t>(0, v - 1)(rng)]
+            .push_back(v);
+    }
+    return tree;
+}
+
+} // namespace
+
+TEST(snapshot_diff_pipeline, reuse_matches_fresh_embedding) {
+    std::mt19937 rng(31);
+    const auto first = random_tree(500, rng);
+    auto second = first;
+    second[second.size() - 1].push_back(second.size());
+    second.emplace_back();
+
+    DyadicTreeMetricEmbedding<Fp> previous(first);
+    const auto super_nodes = previous.super_nodes().size();
+    EXPECT_EQ(previous.recomputed(), first.size());
+
+    // Nothing changed, nothing is computed again.
+    DyadicTreeMetricEmbedding<Fp> same(first, std::move(previous));
+    const DyadicTreeMetricEmbedding<Fp> fresh_same(first);
+    EXPECT_EQ(same.reused(), super_nodes);
+    EXPECT_EQ(same.recomputed(), 0);
+    EXPECT_EQ(same.embedding(), fresh_same.embedding());
+    EXPECT_EQ(same.labels(), fresh_same.labels());
+
+    // Only the heavy paths above the new leaf are labeled again.
+    DyadicTreeMetricEmbedding<Fp> next(second, std::move(same));
+    const DyadicTreeMetricEmbedding<Fp> fresh_next(second);
+    EXPECT_GT(next.reused(), 0);
+    EXPECT_LT(next.reused(), next.super_nodes().size());
+    EXPECT_GT(next.recomputed(), 0);
+    EXPECT_LT(next.recomputed(), second.size() / 10);
+    EXPECT_EQ(next.embedding(), fresh_next.embedding());
+    EXPECT_EQ(next.labels(), fresh_next.labels());
+    for (const auto &[head, wbt] : fresh_next.super_nodes()) {
+        EXPECT_EQ(next.super_nodes().at(head).original_index,
+            wbt.original_index) << "head = " << head;
+    }
+}
+
+TEST(snapshot_diff_pipeline, stream_deltas) {
+    std::mt19937 rng(31);
+    std::vector<tree_type> snapshots;
+    snapshots.push_back(random_tree(300, rng));
+    snapshots.push_back(snapshots.back());
+    snapshots.push_back(snapshots.back());
+    snapshots.back()[7].push_back(snapshots.back().size());
+    snapshots.back().emplace_back();
+    snapshots.push_back(random_tree(200, rng));
+
+    std::stringstream stream;
+    pipeline_type pipeline(stream);
+    std::size_t next = 0;
+    const auto stats = pipeline.run([&](tree_type &tree) {
+        if (next == snapshots.size()) {
+            return false;
+        }
+        tree = snapshots[next++];
+        return true;
+    });
+    ASSERT_EQ(stats.size(), snapshots.size());
+
+    const DyadicTreeMetricEmbedding<Fp> first(snapshots[0]);
+    const auto &first_hpd = first.decomposition();
+    std::size_t heads = 0;
+    for (std::size_t v = 0; v < first.labels().size(); v++) {
+        heads += v >= first_hpd.n || first_hpd.head[v] == v;
+    }
+    EXPECT_EQ(stats[0].changed, heads);
+    EXPECT_EQ(stats[0].reused_super_nodes, 0);
+    EXPECT_EQ(stats[0].recomputed_points, 300);
+    EXPECT_EQ(stats[1].changed, 0);
+    EXPECT_EQ(stats[1].reused_super_nodes, stats[1].super_nodes);
+    EXPECT_EQ(stats[1].recomputed_points, 0);
+    EXPECT_GE(stats[2].changed, 1);
+    EXPECT_LT(stats[2].changed, heads);
+    EXPECT_LT(stats[2].recomputed_points, 301);
+    EXPECT_LT(stats[2].delta_bytes, stats[0].delta_bytes);
+
+    // Applying the deltas reproduces the labels of every snapshot, and the
+    // labels give back its coordinates.
+    std::vector<pipeline_type::label_type> labels;
+    pipeline_type::frame frame;
+    std::size_t frames = 0;
+    std::size_t bytes = 0;
+    for (; pipeline_type::read_frame(stream, frame); frames++) {
+        ASSERT_LT(frames, snapshots.size());
+        EXPECT_EQ(frame.snapshot, frames);
+        EXPECT_EQ(frame.entries.size(), stats[frames].changed);
+        bytes += stats[frames].delta_bytes;
+
+        labels.resize(frame.label_count);
+        for (const auto &[v, path, depth] : frame.entries) {
+            labels[v] = std::make_pair(path, depth);
+        }
+
+        const DyadicTreeMetricEmbedding<Fp> fresh(snapshots[frames]);
+        const auto &hpd = fresh.decomposition();
+        ASSERT_EQ(labels.size(), fresh.labels().size());
+        for (std::size_t v = 0; v < labels.size(); v++) {
+            if (v < hpd.n && hpd.head[v] != v) { continue; }
+            EXPECT_EQ(labels[v], fresh.labels()[v]) << "v = " << v;
+        }
+
+        const auto points = fresh.embedding();
+        const auto label = [&](std::size_t u) { return labels[u]; };
+        for (std::size_t v = 0; v < hpd.n; v++) {
+            EXPECT_EQ(DyadicTreeMetricEmbedding<Fp>::point(
+                fresh.adjacency(), hpd, v, label), points[v]) << "v = " << v;
+        }
+    }
+    EXPECT_EQ(frames, snapshots.size());
+    EXPECT_EQ(bytes, stream.str().size());
+}
@@ -0,0 +1,158 @@
+#include <array>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "lib/dyadic_tree_metric_embedding.hh"
+#include "lib/greedy_property_verifier.hh"
+#include "lib/static_dyadic_tree_metric_embedding.hh"
+
+namespace {
+
+using Fp = long double;
+
+enum v {
+    a = 0,
+    b,
+    c,
+    d,
+    e,
+    f,
+    g,
+    h,
+    i,
+    j,
+    k,
+};
+
+using example_type = StaticDyadicTreeMetricEmbedding<Fp, 11>;
+constexpr example_type example({
+    a, // a root.
+    a, // b.
+    a, // c.
+    a, // d.
+    d, // e.
+    e, // f.
+    h, // g.
+    i, // h.
+    k, // i.
+    k, // j.
+    a, // k.
+});
+
+constexpr std::array<example_type::point, 11> coordinates{{
+    {0x8p-4, 0x8p-4},     // a.
+    {0x8p-11, 0x8p-11},   // b.
+    {0x8.4p-6, 0x8.4p-6}, // c.
+    {0xCp-5, 0x8.02p-5},  // d.
+    {0xCp-5, 0x9.02p-5},  // e.
+    {0xCp-5, 0xA.08p-5},  // f.
+    {0x8p-4, 0xE.1p-4},   // g.
+    {0x8p-4, 0xC.1p-4},   // h.
+    {0x8p-4, 0xA.1p-4},   // i.
+    {0x8.1p-4, 0x8.1p-4}, // j.
+    {0x8p-4, 0x8.1p-4},   // k.
+}};
+
+template <class Embedding, std::size_t N>
+constexpr auto same_points(const Embedding &embedding,
+    const std::array<typename Embedding::point, N> &expected) -> bool {
+    for (std::size_t v = 0; v < N; v++) {
+        if (embedding.embedding()[v].x != expected[v].x ||
+            embedding.embedding()[v].y != expected[v].y) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(same_points(example, coordinates),
+    "coordinates of the example are computed at compile time");
+static_assert(example.label_count() == 17, "a, d, e, h, k, f get dummies");
+
+// Heavy paths on a path graph are greedy in the half plane.
+constexpr StaticDyadicTreeMetricEmbedding<Fp, 5> path({0, 0, 1, 2, 3});
+static_assert(path.greedy_violations(HyperbolicHalfPlaneKernel<Fp>{}) == 0,
+    "a path is embedded greedily");
+
+// Spine 0 - 2 - 4 - ... with a leaf hanging off every spine vertex.
+constexpr StaticDyadicTreeMetricEmbedding<Fp, 11> caterpillar(
+    {0, 0, 0, 2, 2, 4, 4, 6, 6, 8, 8});
+static_assert(path.greedy_violations(path.kernel()) == 0,
+    "a path is greedy in the dyadic tree metric");
+static_assert(caterpillar.greedy_violations(caterpillar.kernel()) == 0,
+    "a caterpillar is greedy in the dyadic tree metric");
+
+// f, the tail of {d, e, f}, has no neighbor closer to g, h, i, j or k (see
+// "Known issues" in the README).
+static_assert(example.greedy_violations(example.kernel()) == 5,
+    "the example has the known violations only");
+
+// Pseudo random tree of a few hundred vertices, it has to stay within
+// -fconstexpr-ops-limit=1048576 (about the clang -fconstexpr-steps default).
+template <std::size_t N>
+constexpr auto random_parents(std::uint64_t seed) -> std::array<std::size_t, N> {
+    std::array<std::size_t, N> parent{};
+    for (std::size_t v = 1; v < N; v++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        parent[v] = (seed >> 33) % v;
+    }
+    return parent;
+}
+
+constexpr auto random_parent = random_parents<300>(30);
+constexpr StaticDyadicTreeMetricEmbedding<Fp, 300> random_tree(random_parent);
+
+template <std::size_t N, class Embedding>
+void expect_same_as_runtime(const std::array<std::size_t, N> &parent,
+    const Embedding &embedding) {
+    using dtme_type = DyadicTreeMetricEmbedding<Fp>;
+    dtme_type::tree_type tree(N);
+    for (std::size_t v = 1; v < N; v++) {
+        tree[parent[v]].push_back(v);
+    }
+    dtme_type dtme(tree);
+
+    const auto points = dtme.embedding();
+    for (std::size_t v = 0; v < N; v++) {
+        EXPECT_EQ(embedding.embedding()[v].x, points[v].first) << "v = " << v;
+        EXPECT_EQ(embedding.embedding()[v].y, points[v].second) << "v = " << v;
+    }
+
+    const auto &labels = dtme.labels();
+    ASSERT_EQ(embedding.label_count(), labels.size());
+    for (std::size_t v = 0; v < labels.size(); v++) {
+        const auto &[path, depth] = labels[v];
+        const auto &l = embedding.label_of(v);
+        EXPECT_EQ(l.high, (path >> 64).to_ullong()) << "v = " << v;
+        EXPECT_EQ(l.low, (path & dtme_type::bitpath(~0ULL)).to_ullong());
+        EXPECT_EQ(l.depth, depth) << "v = " << v;
+    }
+
+    const auto greedy = GreedyPropertyVerifier<Fp>(dtme).verify(
+        DyadicTreeMetricKernel<Fp>(dtme), N, 0, 1);
+    EXPECT_EQ(embedding.greedy_violations(embedding.kernel()),
+        greedy.violating_pairs);
+}
+
+} // namespace
+
+TEST(static_dyadic_tree_metric_embedding, example) {
+    expect_same_as_runtime<11>(
+        {a, a, a, a, d, e, h, i, k, k, a}, example);
+}
+
+TEST(static_dyadic_tree_metric_embedding, random_tree) {
+    expect_same_as_runtime(random_parent, random_tree);
+
+    const auto greedy = GreedyPropertyVerifier<Fp>(
+        DyadicTreeMetricEmbedding<Fp>([] {
+            DyadicTreeMetricEmbedding<Fp>::tree_type tree(random_parent.size());
+            for (std::size_t v = 1; v < tree.size(); v++) {
+                tree[random_parent[v]].push_back(v);
+            }
+            return tree;
+        }())).verify(HyperbolicHalfPlaneKernel<Fp>{}, random_parent.size(), 0, 1);
+    EXPECT_EQ(random_tree.greedy_violations(HyperbolicHalfPlaneKernel<Fp>{}),
+        greedy.violating_pairs);
+}